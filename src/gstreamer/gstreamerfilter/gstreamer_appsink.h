@@ -22,6 +22,15 @@
 #include <adtfstreaming3/sample_serialization_intf.h>
 #include <adtfstreaming3/helper/camelion_streamtype.h>
 
+#include <gst/app/gstappsink.h>
+
+#include <thread>
+
+#include "gstreamer_sample.h"
+
+class cAppSinkFilter;
+GstFlowReturn handle_sample(GstSample* pSample, cAppSinkFilter* pFilter);
+
 class cAppSinkFilter : public cGStreamerBaseFilter
 {
 public:
@@ -33,6 +42,28 @@ public:
     tStreamImageFormat m_sFormat;
     ISampleWriter* m_pWriter;
     object_ptr<adtf::services::IReferenceClock> m_pClock;
+    /// nanoseconds of the stream time as returned by the reference clock
+    typedef decltype(std::declval<adtf::services::IReferenceClock>().GetStreamTimeNs()) tStreamTime;
+
+    property_variable<tBool> m_bZeroCopy = tFalse;
+
+    enum eTimestampMode
+    {
+        TM_ArrivalTime = 0,
+        TM_BufferTime = 1
+    };
+    property_variable<tInt32> m_nTimestampMode = TM_ArrivalTime;
+
+    /// Pull the samples in an own thread instead of the streaming thread of GStreamer.
+    property_variable<tBool> m_bPullMode = tFalse;
+    property_variable<tInt32> m_nMaxBuffers = 4;
+    property_variable<tBool> m_bDrop = tFalse;
+    adtf::system::kernel_thread_looper m_oPullThread;
+
+    /// caps of the last sample, the stream type is only rebuilt if they change
+    GstCaps* m_pLastCaps = nullptr;
+    /// the stream type of the last caps could not be created, their samples would not match the previous one
+    tBool m_bUnsupportedCaps = tFalse;
 
 public:
     cAppSinkFilter()
@@ -47,11 +78,78 @@ public:
         set_stream_type_image_format(*pType, m_sFormat);
         m_pWriter = CreateOutputPin("outpin", pType);
 
+        m_bZeroCopy.SetDescription("Send the GStreamer buffers without copying them. They are held until downstream releases the samples, "
+            "so upstream elements with a small buffer pool (e.g. hardware decoders, v4l2src) may run out of buffers.");
+        RegisterPropertyVariable("zero_copy", m_bZeroCopy);
+
+        m_nTimestampMode.SetDescription("Time of the samples. arrival_time is the stream time the appsink received the sample, buffer_time "
+            "maps the PTS (or DTS) of the buffer through the base time of the pipeline onto the stream time, "
+            "so decoding and queueing delays do not shift it. Falls back to the arrival time for buffers without timestamps.");
+        m_nTimestampMode.SetValueList({
+            {TM_ArrivalTime, "arrival_time"},
+            {TM_BufferTime, "buffer_time"}});
+        RegisterPropertyVariable("timestamp_mode", m_nTimestampMode);
+
+        m_bPullMode.SetDescription("Pull the samples from the appsink in a dedicated thread. The streaming thread of GStreamer only "
+            "queues them up to max_buffers and is not blocked by a slow ADTF graph.");
+        RegisterPropertyVariable("pull_mode", m_bPullMode);
+        m_nMaxBuffers.SetDescription("Maximum number of samples queued in the appsink in pull mode, 0 is unlimited.");
+        RegisterPropertyVariable("max_buffers", m_nMaxBuffers);
+        m_bDrop.SetDescription("Drop the oldest queued sample if max_buffers is reached in pull mode, otherwise the upstream elements block.");
+        RegisterPropertyVariable("drop", m_bDrop);
+
         THROW_IF_FAILED(_runtime->GetObject(m_pClock));
     }
 
+    ~cAppSinkFilter()
+    {
+        gst_caps_replace(&m_pLastCaps, nullptr);
+    }
+
     tResult InitElement(GstElement* pElement) override;
 
+    tResult Start() override
+    {
+        RETURN_IF_FAILED(cGStreamerBaseFilter::Start());
+
+        if (m_bPullMode)
+        {
+            m_oPullThread = adtf::system::kernel_thread_looper(cString(get_named_graph_object_full_name(*this) + "::pull"),
+                &cAppSinkFilter::PullSample, this);
+            if (!m_oPullThread.Joinable())
+            {
+                RETURN_ERROR_DESC(ERR_UNEXPECTED, "Unable to create pull thread");
+            }
+        }
+
+        RETURN_NOERROR;
+    }
+
+    tResult Stop() override
+    {
+        // the pull timeout bounds the join
+        m_oPullThread = adtf::system::kernel_thread_looper();
+        // the stream type is sent again after a restart
+        gst_caps_replace(&m_pLastCaps, nullptr);
+        m_bUnsupportedCaps = tFalse;
+        return cGStreamerBaseFilter::Stop();
+    }
+
+    tVoid PullSample()
+    {
+        // returns nullptr on timeout and at the end of stream, the looper calls us again
+        GstSample* pSample = gst_app_sink_try_pull_sample(GST_APP_SINK(m_pElement), 100 * GST_MSECOND);
+        if (pSample)
+        {
+            handle_sample(pSample, this);
+        }
+        else if (gst_app_sink_is_eos(GST_APP_SINK(m_pElement)))
+        {
+            // does not wait for the timeout anymore
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
     void CreateElement() override
     {
         m_pElement = gst_element_factory_make("appsink", ("my_" + (*m_strName)).GetPtr());
@@ -62,26 +160,94 @@ public:
         }
     }
 
-    tResult SendData(void* pData, tUInt32 nSize)
+    tResult SendData(void* pData, tUInt32 nSize, tStreamTime tmSample, GstBuffer* pGstBuffer)
     {
-        auto tmNow = m_pClock->GetStreamTimeNs();
-
         object_ptr<ISample> pSample;
-        if (IS_OK(alloc_sample(pSample, tmNow)))
+        if (IS_OK(alloc_sample(pSample, tmSample)))
         {
             object_ptr_locked<ISampleBuffer> pBuffer;
             if (IS_OK(pSample->WriteLock(pBuffer, nSize)))
             {
                 adtf_util::cMemoryBlock::MemCopy(pBuffer->GetPtr(), pData, pBuffer->GetSize());
             }
+            set_gstreamer_buffer_info(*pSample, pGstBuffer);
 
             m_pWriter->Write(pSample);
-            m_pWriter->ManualTrigger(tmNow);
+            m_pWriter->ManualTrigger(tmSample);
+        }
+
+        RETURN_NOERROR;
+    }
+
+    tResult SendSample(const object_ptr<cGStreamerSample>& pGstSample)
+    {
+        GstBuffer* pGstBuffer = gst_sample_get_buffer(pGstSample->GetGstSample());
+        tStreamTime tmSample = GetSampleTime(pGstSample->GetGstSample(), pGstBuffer);
+        if (!m_bZeroCopy)
+        {
+            return SendData(pGstSample->GetData(), static_cast<tUInt32>(pGstSample->GetDataSize()), tmSample, pGstBuffer);
         }
 
+        pGstSample->SetTime(tmSample);
+        set_gstreamer_buffer_info(*pGstSample, pGstBuffer);
+
+        object_ptr<const ISample> pSample = pGstSample;
+        m_pWriter->Write(pSample);
+        m_pWriter->ManualTrigger(tmSample);
+
         RETURN_NOERROR;
     }
 
+    /// @return the stream time in nanoseconds of the sample according to the timestamp mode
+    tStreamTime GetSampleTime(GstSample* pSample, GstBuffer* pBuffer)
+    {
+        auto tmNow = m_pClock->GetStreamTimeNs();
+        if (m_nTimestampMode != TM_BufferTime)
+        {
+            return tmNow;
+        }
+
+        GstClockTime tmBuffer = GST_BUFFER_PTS_IS_VALID(pBuffer) ? GST_BUFFER_PTS(pBuffer) : GST_BUFFER_DTS(pBuffer);
+        GstSegment* pSegment = gst_sample_get_segment(pSample);
+        GstClock* pClock = gst_element_get_clock(m_pElement);
+        if (!GST_CLOCK_TIME_IS_VALID(tmBuffer) || !pSegment || !pClock)
+        {
+            if (pClock)
+            {
+                gst_object_unref(pClock);
+            }
+            return tmNow;
+        }
+
+        // the buffer is rendered at base time + running time on the pipeline clock, its age on that clock
+        // is subtracted from the stream time read right before, which keeps both clocks free of drift
+        GstClockTime tmRunning = gst_segment_to_running_time(pSegment, GST_FORMAT_TIME, tmBuffer);
+        GstClockTime tmPipeline = gst_clock_get_time(pClock);
+        gst_object_unref(pClock);
+        if (!GST_CLOCK_TIME_IS_VALID(tmRunning))
+        {
+            return tmNow;
+        }
+
+        const GstClockTimeDiff tmAge = GST_CLOCK_DIFF(gst_element_get_base_time(m_pElement) + tmRunning, tmPipeline);
+        return tmNow - tStreamTime(tmAge);
+    }
+
+    /// @return tTrue if the caps differ from the ones of the last sample
+    tBool CapsChanged(GstCaps* pCaps)
+    {
+        // consecutive samples usually share the caps object, the deep compare is only needed after a renegotiation
+        if (m_pLastCaps == pCaps)
+        {
+            return tFalse;
+        }
+
+        const tBool bChanged = !m_pLastCaps || !gst_caps_is_equal(m_pLastCaps, pCaps);
+        // keep the new object so the next sample is a pointer compare again
+        gst_caps_replace(&m_pLastCaps, pCaps);
+        return bChanged;
+    }
+
     tResult SampleType(const adtf::util::cString & strName, const std::map<adtf::util::cString, adtf::util::cVariant> & oProperties)
     {
         if (strName == "video/x-raw")
@@ -108,40 +274,53 @@ public:
         RETURN_NOERROR;
     }
 
+    /// Called for every change of the caps, so a change of the pixel format alone changes the stream type as well.
     tResult SampleType(tInt32 nWidth, tInt32 nHeight, const adtf::util::cString & strFormat)
     {
-        if (m_sFormat.m_ui32Width != nWidth || m_sFormat.m_ui32Height != nHeight)
+        tStreamImageFormat sFormat;
+        sFormat.m_ui32Width = nWidth;
+        sFormat.m_ui32Height = nHeight;
+
+        if (strFormat == "GRAY8")
+        {
+            sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(GREYSCALE_8);
+            sFormat.m_szMaxByteSize = nWidth * nHeight;
+        }
+        /*else if (nDeep == 12)
+        {
+            sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(YUV420P);
+            sFormat.m_szMaxByteSize = (nWidth * nHeight * 12) / 8;
+        }*/
+        else if (strFormat == "RGB")
+        {
+            sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGB_24);
+            sFormat.m_szMaxByteSize = nWidth * nHeight * 3;
+        }
+        else if (strFormat == "RGBA")
+        {
+            sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGBA_32);
+            sFormat.m_szMaxByteSize = nWidth * nHeight * 4;
+        }
+        else
         {
-            m_sFormat.m_ui32Width = nWidth;
-            m_sFormat.m_ui32Height = nHeight;
+            RETURN_ERROR_DESC(ERR_NOT_SUPPORTED, "Raw video format %s is not supported", strFormat.GetPtr());
+        }
+        sFormat.m_ui8DataEndianess = PLATFORM_BYTEORDER;
 
-            if (strFormat == "GRAY8")
-            {
-                m_sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(GREYSCALE_8);
-                m_sFormat.m_szMaxByteSize = nWidth * nHeight;
-            }
-            /*else if (nDeep == 12)
-            {
-                m_sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(YUV420P);
-                m_sFormat.m_szMaxByteSize = (nWidth * nHeight * 12) / 8;
-            }*/
-            else if (strFormat == "RGB")
-            {
-                m_sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGB_24);
-                m_sFormat.m_szMaxByteSize = nWidth * nHeight * 3;
-            }
-            else if (strFormat == "RGBA")
-            {
-                m_sFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGBA_32);
-                m_sFormat.m_szMaxByteSize = nWidth * nHeight * 4;
-            }
+        // e.g. only the framerate changed
+        if (sFormat.m_ui32Width == m_sFormat.m_ui32Width &&
+            sFormat.m_ui32Height == m_sFormat.m_ui32Height &&
+            sFormat.m_szMaxByteSize == m_sFormat.m_szMaxByteSize &&
+            sFormat.m_strFormatName == m_sFormat.m_strFormatName)
+        {
+            RETURN_NOERROR;
+        }
 
-            m_sFormat.m_ui8DataEndianess = PLATFORM_BYTEORDER;
-            object_ptr<IStreamType> pType = make_object_ptr<cStreamType>(stream_meta_type_image());
-            set_stream_type_image_format(*pType, m_sFormat);
+        m_sFormat = sFormat;
+        object_ptr<IStreamType> pType = make_object_ptr<cStreamType>(stream_meta_type_image());
+        set_stream_type_image_format(*pType, m_sFormat);
 
-            m_pWriter->ChangeType(pType);
-        }
+        m_pWriter->ChangeType(pType);
         RETURN_NOERROR;
     }
 };
@@ -161,7 +340,9 @@ std::map<cString, cVariant> GetProperties(GstStructure* pCapsStruct)
 {
     std::map<cString, cVariant> oMap;
     gst_structure_foreach(pCapsStruct, foreach, &oMap);
-    oMap["gst_structure"] = gst_structure_to_string(pCapsStruct);
+    gchar* strStructure = gst_structure_to_string(pCapsStruct);
+    oMap["gst_structure"] = strStructure;
+    g_free(strStructure);
     return oMap;
 }
 
@@ -171,28 +352,29 @@ GstFlowReturn new_sample(GstElement* pSink, cAppSinkFilter* pFilter) {
     GstSample *pSample;
     /* Retrieve the buffer */
     g_signal_emit_by_name(pSink, "pull-sample", &pSample);
+    return handle_sample(pSample, pFilter);
+}
+
+/// Sends a pulled sample to ADTF, in the streaming thread or the pull thread.
+GstFlowReturn handle_sample(GstSample* pSample, cAppSinkFilter* pFilter)
+{
     if (pSample)
     {
-        /* The only thing we do in this example is print a * to indicate a received buffer */
-        GstBuffer * pBuffer = gst_sample_get_buffer(pSample);
-        if (!pBuffer)
+        // owns the reference and the mapping from here on, they are released with the last ADTF reference
+        object_ptr<cGStreamerSample> pGstSample = make_object_ptr<cGStreamerSample>(pSample);
+        if (!gst_sample_get_buffer(pSample))
         {
             LOG_ERROR("gst_sample_get_buffer() returned NULL");
             return GST_FLOW_OK;
         }
 
-        GstMapInfo oMap;
-
-        if (!gst_buffer_map(pBuffer, &oMap, GST_MAP_READ))
+        if (!pGstSample->IsMapped())
         {
             LOG_ERROR("gst_buffer_map() failed");
             return GST_FLOW_OK;
         }
 
-        void* pData = oMap.data; //GST_BUFFER_DATA(gstBuffer);
-        const gsize nSize = oMap.size; //GST_BUFFER_SIZE(gstBuffer);
-
-        if (!pData)
+        if (!pGstSample->GetData())
         {
             LOG_ERROR("gst_buffer had NULL data pointer");
             return GST_FLOW_OK;
@@ -242,25 +424,41 @@ GstFlowReturn new_sample(GstElement* pSink, cAppSinkFilter* pFilter) {
         }
         */
 
-        auto oProperties = GetProperties(pCapsStruct);
-        pFilter->SampleType(gst_structure_get_name(pCapsStruct), oProperties);
+        if (pFilter->CapsChanged(pCaps))
+        {
+            auto oProperties = GetProperties(pCapsStruct);
+            pFilter->m_bUnsupportedCaps = IS_FAILED(pFilter->SampleType(gst_structure_get_name(pCapsStruct), oProperties));
+            if (pFilter->m_bUnsupportedCaps)
+            {
+                LOG_ERROR("Unable to create the stream type for the caps of the appsink, samples are dropped until the caps change");
+            }
+        }
+
+        if (pFilter->m_bUnsupportedCaps)
+        {
+            return GST_FLOW_OK;
+        }
 
         /*pFilter->SampleType(nWidth, nHeight, 
             static_cast<tInt32>((nSize * 8) / (nWidth * nHeight)), 
             static_cast<tInt32>(nSize / nHeight));*/
-        pFilter->SendData(pData, static_cast<tInt32>(nSize));
-
-        //@TODO Make sure all return are memory leak free
-        gst_buffer_unmap(pBuffer, &oMap);
-        //gst_buffer_unref(pBuffer);
-        gst_sample_unref(pSample);
+        pFilter->SendSample(pGstSample);
     }
     return GST_FLOW_OK;
 }
 
 tResult cAppSinkFilter::InitElement(GstElement* pElement)
 {
-    g_object_set(m_pElement, "emit-signals", TRUE, NULL);
-    g_signal_connect(m_pElement, "new-sample", G_CALLBACK(new_sample), this);
+    if (m_bPullMode)
+    {
+        g_object_set(m_pElement, "emit-signals", FALSE, NULL);
+        g_object_set(m_pElement, "max-buffers", static_cast<guint>(std::max<tInt32>(m_nMaxBuffers, 0)), NULL);
+        g_object_set(m_pElement, "drop", m_bDrop ? TRUE : FALSE, NULL);
+    }
+    else
+    {
+        g_object_set(m_pElement, "emit-signals", TRUE, NULL);
+        g_signal_connect(m_pElement, "new-sample", G_CALLBACK(new_sample), this);
+    }
     RETURN_NOERROR;
 }
\ No newline at end of file
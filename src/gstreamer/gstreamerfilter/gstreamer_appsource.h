@@ -37,7 +37,18 @@ public:
 
     property_variable<tBool> m_bBinary = tFalse;
 
-    
+    property_variable<tBool> m_bZeroCopy = tTrue;
+    /// fallback for copied frames, recycles the GstBuffers instead of allocating one per frame
+    GstBufferPool* m_pBufferPool = nullptr;
+    tSize m_nPoolBufferSize = 0;
+
+    /// keeps the ADTF sample and its memory locked while GStreamer uses the wrapped memory
+    struct tWrappedSample
+    {
+        object_ptr<const ISample> pSample;
+        object_ptr_shared_locked<const ISampleBuffer> pBuffer;
+    };
+
 public:
     cAppSourceFilter()
     {
@@ -56,6 +67,15 @@ public:
         });
 
         RegisterPropertyVariable("binary", m_bBinary);
+
+        m_bZeroCopy.SetDescription("Push the memory of the ADTF samples without copying it. The samples stay locked until GStreamer released "
+            "the buffers. Disable it if downstream elements write into the buffers in place, the frames are then copied into pooled buffers.");
+        RegisterPropertyVariable("zero_copy", m_bZeroCopy);
+    }
+
+    ~cAppSourceFilter()
+    {
+        ReleaseBufferPool();
     }
 
     void CreateElement() override
@@ -82,10 +102,27 @@ public:
         adtf::ucom::object_ptr_shared_locked<const adtf::streaming::ISampleBuffer> pSampleBuffer;
         if (IS_OK(pSample->Lock(pSampleBuffer)))
         {
-            tInt32 nSize = m_sFormat.m_ui32Width * m_sFormat.m_ui32Height * m_nChannel;
-            auto pBuffer = gst_buffer_new_allocate(NULL, nSize, NULL);
+            tSize nSize = m_sFormat.m_ui32Width * m_sFormat.m_ui32Height * m_nChannel;
+            if (m_bBinary)
+            {
+                nSize = pSampleBuffer->GetSize();
+            }
 
-            gst_buffer_fill(pBuffer, 0, pSampleBuffer->GetPtr(), pSampleBuffer->GetSize());
+            // a sample smaller than the frame can not be wrapped, it is copied into a buffer of the full frame size
+            GstBuffer* pBuffer = nullptr;
+            if (m_bZeroCopy && pSampleBuffer->GetPtr() && pSampleBuffer->GetSize() >= nSize)
+            {
+                pBuffer = WrapSample(pSample, std::move(pSampleBuffer), nSize);
+            }
+            else
+            {
+                pBuffer = CopySample(*pSampleBuffer, nSize);
+            }
+
+            if (!pBuffer)
+            {
+                RETURN_ERROR_DESC(ERR_MEMORY, "Unable to create a GstBuffer of %d bytes", static_cast<tInt32>(nSize));
+            }
 
             GstFlowReturn oResult = gst_app_src_push_buffer(GST_APP_SRC(m_pElement), pBuffer);
             if (oResult != GST_FLOW_OK)
@@ -96,6 +133,64 @@ public:
         RETURN_NOERROR;
     }
 
+    /// Wraps the locked sample memory read only, GStreamer copies it if an element needs to write into it.
+    GstBuffer* WrapSample(const adtf::ucom::iobject_ptr<const ISample>& pSample,
+        object_ptr_shared_locked<const ISampleBuffer> && pSampleBuffer, tSize nSize)
+    {
+        tWrappedSample* pWrapped = new tWrappedSample();
+        pWrapped->pSample = pSample;
+        pWrapped->pBuffer = std::move(pSampleBuffer);
+
+        // GstMemory has no const variant, the read only flag protects the ADTF memory
+        return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+            const_cast<tVoid*>(pWrapped->pBuffer->GetPtr()), pWrapped->pBuffer->GetSize(), 0, nSize,
+            pWrapped, [](gpointer pData)
+        {
+            // may be called from any streaming thread of the pipeline
+            delete static_cast<tWrappedSample*>(pData);
+        });
+    }
+
+    GstBuffer* CopySample(const ISampleBuffer & oSampleBuffer, tSize nSize)
+    {
+        if (!m_pBufferPool || m_nPoolBufferSize != nSize)
+        {
+            ReleaseBufferPool();
+
+            m_pBufferPool = gst_buffer_pool_new();
+            GstStructure* pConfig = gst_buffer_pool_get_config(m_pBufferPool);
+            gst_buffer_pool_config_set_params(pConfig, nullptr, static_cast<guint>(nSize), 2, 0);
+            if (!gst_buffer_pool_set_config(m_pBufferPool, pConfig) || !gst_buffer_pool_set_active(m_pBufferPool, TRUE))
+            {
+                LOG_ERROR("Unable to activate the buffer pool");
+                ReleaseBufferPool();
+                return nullptr;
+            }
+            m_nPoolBufferSize = nSize;
+        }
+
+        GstBuffer* pBuffer = nullptr;
+        if (gst_buffer_pool_acquire_buffer(m_pBufferPool, &pBuffer, nullptr) != GST_FLOW_OK)
+        {
+            return nullptr;
+        }
+
+        gst_buffer_fill(pBuffer, 0, oSampleBuffer.GetPtr(), std::min(oSampleBuffer.GetSize(), nSize));
+        return pBuffer;
+    }
+
+    tVoid ReleaseBufferPool()
+    {
+        if (m_pBufferPool)
+        {
+            // the buffers still in use return to the inactive pool and are freed then
+            gst_buffer_pool_set_active(m_pBufferPool, FALSE);
+            gst_object_unref(m_pBufferPool);
+            m_pBufferPool = nullptr;
+        }
+        m_nPoolBufferSize = 0;
+    }
+
     tResult AddGStreamerFilter(cGStreamerBaseFilter * pParentFilter, cGStreamerBaseFilter * pRootFilter) override
     {
         RETURN_IF_FAILED(InitElement(m_pElement));
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <adtffiltersdk/adtf_filtersdk.h>
+#include <adtfsystemsdk/adtf_systemsdk.h>
 
 using namespace adtf::util;
 using namespace adtf::ucom;
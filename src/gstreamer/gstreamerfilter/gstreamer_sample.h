@@ -0,0 +1,232 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <memory>
+
+/// Sample flags set by the appsink, taken from the flags of the GstBuffer.
+enum eGStreamerSampleFlags : tUInt32
+{
+    GSF_Delta = 0x1,     ///< GST_BUFFER_FLAG_DELTA_UNIT, the frame is no keyframe
+    GSF_Discont = 0x2    ///< GST_BUFFER_FLAG_DISCONT, samples were lost before this one
+};
+
+/// Sample infos set by the appsink, in nanoseconds. Missing if the GstBuffer has no valid value.
+static constexpr const tChar* const GSTREAMER_SAMPLE_INFO_DURATION = "gst_duration";
+static constexpr const tChar* const GSTREAMER_SAMPLE_INFO_PTS = "gst_pts";
+static constexpr const tChar* const GSTREAMER_SAMPLE_INFO_DTS = "gst_dts";
+
+/// Copies the flags, the duration and the raw timestamps of the GstBuffer into the ADTF sample.
+inline tVoid set_gstreamer_buffer_info(ISample& oSample, GstBuffer* pBuffer)
+{
+    tUInt32 nFlags = 0;
+    if (GST_BUFFER_FLAG_IS_SET(pBuffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    {
+        nFlags |= GSF_Delta;
+    }
+    if (GST_BUFFER_FLAG_IS_SET(pBuffer, GST_BUFFER_FLAG_DISCONT))
+    {
+        nFlags |= GSF_Discont;
+    }
+    oSample.SetFlags(nFlags);
+
+    if (GST_BUFFER_DURATION_IS_VALID(pBuffer))
+    {
+        adtf::streaming::set_sample_info(oSample, GSTREAMER_SAMPLE_INFO_DURATION, static_cast<tInt64>(GST_BUFFER_DURATION(pBuffer)));
+    }
+    if (GST_BUFFER_PTS_IS_VALID(pBuffer))
+    {
+        adtf::streaming::set_sample_info(oSample, GSTREAMER_SAMPLE_INFO_PTS, static_cast<tInt64>(GST_BUFFER_PTS(pBuffer)));
+    }
+    if (GST_BUFFER_DTS_IS_VALID(pBuffer))
+    {
+        adtf::streaming::set_sample_info(oSample, GSTREAMER_SAMPLE_INFO_DTS, static_cast<tInt64>(GST_BUFFER_DTS(pBuffer)));
+    }
+}
+
+/// Reference and read mapping of a GstSample, shared by the ADTF sample and all its locked buffers.
+class cGStreamerMapping
+{
+private:
+    GstSample* m_pSample;
+    GstBuffer* m_pBuffer;
+    GstMapInfo m_sMap;
+    tBool m_bMapped;
+
+public:
+    /// Takes over the reference of pSample.
+    cGStreamerMapping(GstSample* pSample) :
+        m_pSample(pSample),
+        m_pBuffer(gst_sample_get_buffer(pSample)),
+        m_bMapped(tFalse)
+    {
+        if (m_pBuffer)
+        {
+            m_bMapped = gst_buffer_map(m_pBuffer, &m_sMap, GST_MAP_READ) ? tTrue : tFalse;
+        }
+    }
+
+    ~cGStreamerMapping()
+    {
+        if (m_bMapped)
+        {
+            gst_buffer_unmap(m_pBuffer, &m_sMap);
+        }
+        gst_sample_unref(m_pSample);
+    }
+
+    cGStreamerMapping(const cGStreamerMapping&) = delete;
+    cGStreamerMapping& operator=(const cGStreamerMapping&) = delete;
+
+    GstSample* GetGstSample() const
+    {
+        return m_pSample;
+    }
+
+    tBool IsMapped() const
+    {
+        return m_bMapped;
+    }
+
+    tVoid* GetData() const
+    {
+        return m_bMapped ? m_sMap.data : nullptr;
+    }
+
+    tSize GetDataSize() const
+    {
+        return m_bMapped ? m_sMap.size : 0;
+    }
+};
+
+/**
+ * Sample which exposes the mapped memory of a GstSample to ADTF without copying it.
+ * The GstSample stays referenced and mapped until the sample and the last locked buffer are released.
+ */
+class cGStreamerSample : public adtf::ucom::object<adtf::streaming::cSample>
+{
+private:
+    std::shared_ptr<const cGStreamerMapping> m_pMapping;
+
+public:
+    /// Takes over the reference of pSample.
+    cGStreamerSample(GstSample* pSample) :
+        m_pMapping(std::make_shared<cGStreamerMapping>(pSample))
+    {
+    }
+
+    GstSample* GetGstSample() const
+    {
+        return m_pMapping->GetGstSample();
+    }
+
+    tBool IsMapped() const
+    {
+        return m_pMapping->IsMapped();
+    }
+
+    tVoid* GetData() const
+    {
+        return m_pMapping->GetData();
+    }
+
+    tSize GetDataSize() const
+    {
+        return m_pMapping->GetDataSize();
+    }
+
+public:
+    tResult Lock(adtf::ucom::ant::iobject_ptr_shared_locked<const adtf::streaming::ant::ISampleBuffer>& oSampleBuffer) const override;
+};
+
+/// Read only view on the mapped memory of a cGStreamerSample, keeps the mapping alive on its own.
+class cGStreamerSampleBuffer : public adtf::ucom::object<cSharedLockedObject, ISampleBuffer>
+{
+private:
+    std::shared_ptr<const cGStreamerMapping> m_pMapping;
+
+public:
+    cGStreamerSampleBuffer(const std::shared_ptr<const cGStreamerMapping>& pMapping) :
+        m_pMapping(pMapping)
+    {
+
+    }
+
+    virtual tResult Write(const adtf::base::ant::IRawMemory& oBufferWrite)
+    {
+        RETURN_ERROR(ERR_NOT_IMPL);
+    };
+    virtual tResult Read(adtf::base::ant::IRawMemory&& oBufferRead) const
+    {
+        RETURN_ERROR(ERR_NOT_IMPL);
+    };
+    virtual tVoid*  GetPtr()
+    {
+        return m_pMapping->GetData();
+    };
+    virtual const tVoid* GetPtr() const
+    {
+        return m_pMapping->GetData();
+    }
+    virtual tSize   GetSize() const
+    {
+        return m_pMapping->GetDataSize();
+    };
+    virtual tSize   GetCapacity() const
+    {
+        return GetSize();
+    };
+    virtual tResult   Reserve(tSize szSize)
+    {
+        RETURN_ERROR(ERR_NOT_IMPL);
+    };
+    virtual tResult   Resize(tSize szSize)
+    {
+        RETURN_ERROR(ERR_NOT_IMPL);
+    };
+
+    tResult Lock() const override
+    {
+        RETURN_NOERROR;
+    }
+
+    tResult Unlock() const override
+    {
+        RETURN_NOERROR;
+    }
+
+    tResult LockShared() const override
+    {
+        RETURN_NOERROR;
+    }
+
+    tResult UnlockShared() const override
+    {
+        RETURN_NOERROR;
+    }
+};
+
+inline tResult cGStreamerSample::Lock(adtf::ucom::ant::iobject_ptr_shared_locked<const adtf::streaming::ant::ISampleBuffer>& oSampleBuffer) const
+{
+    object_ptr<const ISampleBuffer> pBuffer = make_object_ptr<cGStreamerSampleBuffer>(m_pMapping);
+    oSampleBuffer.Reset(pBuffer);
+
+    RETURN_NOERROR;
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <opencv_base_filter/detection.h>
+
+using namespace adtf::ucom;
+using namespace adtf::streaming;
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+tResult create_detection_sample(object_ptr<ISample>& pSample, const std::vector<tDetection>& vecDetections)
+{
+    RETURN_IF_FAILED(alloc_sample(pSample));
+
+    object_ptr_locked<ISampleBuffer> pBuffer;
+    RETURN_IF_FAILED(pSample->WriteLock(pBuffer, vecDetections.size() * sizeof(tDetection)));
+    if (!vecDetections.empty())
+    {
+        adtf_util::cMemoryBlock::MemCopy(pBuffer->GetPtr(), vecDetections.data(), vecDetections.size() * sizeof(tDetection));
+    }
+
+    RETURN_NOERROR;
+}
+
+tResult get_detections(std::vector<tDetection>& vecDetections, const ISample& oSample)
+{
+    object_ptr_shared_locked<const ISampleBuffer> pBuffer;
+    RETURN_IF_FAILED(oSample.Lock(pBuffer));
+
+    if (pBuffer->GetSize() % sizeof(tDetection) != 0)
+    {
+        RETURN_ERROR_DESC(ERR_INVALID_ARG, "Sample size %d is no multiple of the detection size", static_cast<tInt32>(pBuffer->GetSize()));
+    }
+
+    const tDetection* pDetections = static_cast<const tDetection*>(pBuffer->GetPtr());
+    vecDetections.assign(pDetections, pDetections + pBuffer->GetSize() / sizeof(tDetection));
+
+    RETURN_NOERROR;
+}
+
+}
+}
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtf_streaming3.h>
+
+#include <vector>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * One detected object. The box is normalized to the size of the image the detection belongs to,
+ * so consumers do not need to know the input size or the preprocessing of the net.
+ */
+struct tDetection
+{
+    tFloat32 fLeft;
+    tFloat32 fTop;
+    tFloat32 fWidth;
+    tFloat32 fHeight;
+    tInt32 nClassId;
+    tFloat32 fScore;
+};
+
+/// The samples of this stream type contain a plain array of tDetection.
+struct stream_meta_type_detections
+{
+    static constexpr const tChar *const MetaTypeName = "opencv/detections";
+
+    static constexpr const tChar *const DetectionSize = "detection_size";
+
+    static tVoid SetProperties(const adtf::ucom::iobject_ptr<adtf::base::IProperties>& pProperties)
+    {
+        pProperties->SetProperty(adtf::base::property<tUInt>(DetectionSize, sizeof(tDetection)));
+    }
+};
+
+tResult create_detection_sample(adtf::ucom::object_ptr<adtf::streaming::ISample>& pSample, const std::vector<tDetection>& vecDetections);
+tResult get_detections(std::vector<tDetection>& vecDetections, const adtf::streaming::ISample& oSample);
+
+}
+}
+}
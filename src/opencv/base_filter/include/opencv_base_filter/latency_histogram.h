@@ -0,0 +1,129 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtf_utils.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Lock free latency histogram with logarithmic buckets in the style of HdrHistogram.
+ *
+ * Every power of two is split into 16 linear sub-buckets, so a percentile is precise to about 6%
+ * from 1 ns up to the full 64 bit range. Recording is a relaxed atomic increment and may be done
+ * from any number of threads.
+ */
+class cLatencyHistogram
+{
+public:
+    cLatencyHistogram();
+
+    tVoid Record(tUInt64 nNanoseconds);
+
+    tUInt64 GetCount() const;
+    tUInt64 GetMax() const;
+
+    /**
+     * @param fQuantile e.g. 0.99 for the 99th percentile
+     * @return the highest value of the bucket containing the quantile in ns, 0 if nothing was recorded
+     */
+    tUInt64 GetPercentile(tFloat64 fQuantile) const;
+
+    /// Not synchronized with Record, values recorded meanwhile may be lost.
+    tVoid Reset();
+
+private:
+    static const tSize s_nSubBuckets = 16;
+    static const tSize s_nBuckets = 61 * s_nSubBuckets;
+
+    static tSize GetBucket(tUInt64 nValue);
+    static tUInt64 GetLowestValue(tSize nBucket);
+
+    std::atomic<tUInt64> m_arrBuckets[s_nBuckets];
+    std::atomic<tUInt64> m_nMax;
+};
+
+/// Records consecutive stages with one clock read per stage.
+class cLatencyStopwatch
+{
+public:
+    explicit cLatencyStopwatch(tBool bEnabled) :
+        m_bEnabled(bEnabled)
+    {
+        if (m_bEnabled)
+        {
+            m_tmLast = std::chrono::steady_clock::now();
+        }
+    }
+
+    /// Records the time since the construction or the previous lap, does nothing for a null histogram.
+    tVoid Lap(cLatencyHistogram* pHistogram)
+    {
+        if (m_bEnabled && pHistogram)
+        {
+            auto tmNow = std::chrono::steady_clock::now();
+            pHistogram->Record(static_cast<tUInt64>(std::chrono::duration_cast<std::chrono::nanoseconds>(tmNow - m_tmLast).count()));
+            m_tmLast = tmNow;
+        }
+    }
+
+private:
+    tBool m_bEnabled;
+    std::chrono::steady_clock::time_point m_tmLast;
+};
+
+/// Records the time from its construction to its destruction, does nothing for a null histogram.
+class cLatencyTimer
+{
+public:
+    explicit cLatencyTimer(cLatencyHistogram* pHistogram) :
+        m_pHistogram(pHistogram)
+    {
+        if (m_pHistogram)
+        {
+            m_tmStart = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~cLatencyTimer()
+    {
+        if (m_pHistogram)
+        {
+            m_pHistogram->Record(static_cast<tUInt64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_tmStart).count()));
+        }
+    }
+
+private:
+    cLatencyHistogram* m_pHistogram;
+    std::chrono::steady_clock::time_point m_tmStart;
+};
+
+}
+}
+}
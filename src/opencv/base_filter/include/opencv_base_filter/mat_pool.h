@@ -0,0 +1,79 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <adtf_utils.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Pool of preallocated cv::Mat buffers keyed by (rows, cols, type).
+ *
+ * The pool keeps one reference on every buffer it ever handed out. A buffer is
+ * free again as soon as its reference count drops back to one, i.e. when the
+ * last cOpenCVSample (or any other cv::Mat header) sharing it has been released.
+ * No explicit return call is necessary.
+ */
+class cMatPool
+{
+public:
+    cMatPool(tSize nMaxBuffers = 4);
+
+    /**
+     * Hands out a free buffer of the requested geometry. If all pooled buffers are still
+     * referenced and the pool is full, an unpooled cv::Mat is allocated instead.
+     * @param [out] bHit tTrue if a preallocated buffer could be reused
+     */
+    cv::Mat Acquire(tInt nRows, tInt nCols, tInt nType, tBool & bHit);
+
+    tVoid SetMaxBuffers(tSize nMaxBuffers);
+    tVoid Clear();
+
+    tUInt64 GetHits() const;
+    tUInt64 GetMisses() const;
+
+private:
+    typedef std::tuple<tInt, tInt, tInt> tKey;
+
+    tBool EvictUnused(const tKey & oKeep);
+
+    mutable std::mutex m_oMutex;
+    std::map<tKey, std::vector<cv::Mat>> m_mapBuffers;
+    tSize m_nMaxBuffers;
+    tSize m_nBufferCount = 0;
+
+    tUInt64 m_nHits = 0;
+    tUInt64 m_nMisses = 0;
+};
+
+}
+}
+}
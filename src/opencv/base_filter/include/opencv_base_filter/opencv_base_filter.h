@@ -20,8 +20,18 @@
 #pragma once
 
 #include <adtffiltersdk/adtf_filtersdk.h>
+#include <adtfsystemsdk/adtf_systemsdk.h>
 #include <opencv2/opencv.hpp>
 
+#include <opencv_base_filter/mat_pool.h>
+#include <opencv_base_filter/sample_queue.h>
+#include <opencv_base_filter/reorder_buffer.h>
+#include <opencv_base_filter/latency_histogram.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 namespace adtf
 {
 namespace videotb
@@ -31,21 +41,76 @@ namespace opencv
 
     adtf::streaming::tStreamImageFormat create_stream_type(const cv::Mat & oMat);
     tResult check_stream_type(const cv::Mat & oMat, adtf::streaming::tStreamImageFormat & oCurrentType, adtf::filter::cPinWriter* pOutput);
+    tInt get_mat_type(const adtf::streaming::tStreamImageFormat & oImageFormat);
 
     class cOpenCVBaseFilter : public adtf::filter::cFilter
     {
-    private:
+    protected:
         adtf::filter::cPinWriter* m_pOutput;
         adtf::filter::cPinReader* m_pInput;
 
+    private:
+        /// Geometry of the pooled output buffers, a copy of the output format the worker threads can read.
+        struct tOutputGeometry
+        {
+            tInt nRows = 0;
+            tInt nCols = 0;
+            tInt nType = -1;
+        };
+
+        /// only accessed by the accept type callback of the input pin
         adtf::streaming::tStreamImageFormat m_sCurrentFormat;
+        std::mutex m_oGeometryMutex;
+        tOutputGeometry m_sOutputGeometry;
+
+        cMatPool m_oMatPool;
+        /// a hit is only counted if the result really lives in the pooled buffer, the pool itself cannot know that
+        std::atomic<tUInt64> m_nPoolHits;
+        std::atomic<tUInt64> m_nPoolMisses;
+        /// the statistics are published by the trigger thread only, the workers just request an update
+        tUInt32 m_nStatisticsRequests;
+        std::atomic<tBool> m_bStatisticsDue;
+
+        cSampleQueue m_oQueue;
+        cReorderBuffer m_oReorderBuffer;
+        std::vector<adtf::system::kernel_thread_looper> m_vecWorkers;
+
+        std::vector<std::unique_ptr<cLatencyHistogram>> m_vecLatencyStages;
+        std::vector<adtf::util::cString> m_vecLatencyStageNames;
+        tSize m_nProcessStage;
+        tSize m_nWriteStage;
+        std::atomic<tUInt32> m_nLatencyFrames;
+        std::atomic<tInt64> m_nNextLatencyDump;
+
+    protected:
+        /// Maximum number of pooled output buffers, 0 disables the pool.
+        adtf::base::property_variable<tInt32> m_nMatPoolSize = 4;
+
+        /// Process the samples in a dedicated worker thread instead of the trigger thread.
+        adtf::base::property_variable<tBool> m_bAsync = tFalse;
+        adtf::base::property_variable<tInt32> m_nQueueSize = 4;
+        adtf::base::property_variable<tInt32> m_nOverflowPolicy = cSampleQueue::OP_DropOldest;
+        /// Number of worker threads in async mode. More than one requires a thread safe (stateless) ProcessMat.
+        adtf::base::property_variable<tInt32> m_nWorkerThreads = 1;
+
+        /// Record the duration of the processing stages, see AddLatencyStage.
+        adtf::base::property_variable<tBool> m_bLatencyHistograms = tFalse;
+        adtf::base::property_variable<tInt32> m_nLatencyLogInterval = 10;
 
     public:
         cOpenCVBaseFilter();
 
         virtual adtf::streaming::tStreamImageFormat ConvertImageFormat(const adtf::streaming::tStreamImageFormat & oImageFormat);
 
-        virtual cv::Mat ProcessMat(const cv::Mat & oMat) = 0;
+        /**
+         * Processes one input Mat.
+         * @param [in] oMat the input image
+         * @param [in,out] oResult a pooled buffer matching the output format (empty if the pool is disabled
+         *                 or the format is unknown). Write into it to avoid a new allocation per frame.
+         */
+        virtual tResult ProcessMat(const cv::Mat & oMat, cv::Mat & oResult);
+        /// Legacy overload, only called by the default implementation above. Logs an error if neither overload is implemented.
+        virtual cv::Mat ProcessMat(const cv::Mat & oMat);
         virtual tResult OnStageFirst() { RETURN_NOERROR; };
         virtual tResult OnStagePreConnect() { RETURN_NOERROR; };
         virtual tResult OnStagePostConnect() { RETURN_NOERROR; };
@@ -54,6 +119,36 @@ namespace opencv
             const adtf::ucom::iobject_ptr<const adtf::streaming::ISample>& pSample);
 
         tResult Init(adtf::streaming::ant::cFilterLevelmachine::tInitStage eStage);
+        tResult Start() override;
+        tResult Stop() override;
+
+    protected:
+        /**
+         * Registers a named stage whose durations are collected in a histogram. The percentiles are published as
+         * properties latency_<name>_p50/_p99/_p999/_max in microseconds. Call it in the constructor or OnStageFirst.
+         * @return the id for GetLatencyStage
+         */
+        tSize AddLatencyStage(const adtf::util::cString & strName);
+
+        /// @return the histogram of the stage for a cLatencyTimer or cLatencyStopwatch, nullptr if the histograms are disabled
+        cLatencyHistogram* GetLatencyStage(tSize nStage);
+
+        /**
+         * Processes one input sample, in the trigger thread or a worker thread in async mode.
+         * The default unpacks the Mat and calls ProcessMat. Override it if the result depends on more than the Mat.
+         * @param [in] pSample the input sample
+         * @param [out] pOutSample the sample for mat_out, left empty if there is none
+         */
+        virtual tResult ProcessSample(const adtf::ucom::iobject_ptr<const adtf::streaming::ISample>& pSample,
+            adtf::ucom::object_ptr<const adtf::streaming::ISample>& pOutSample);
+
+    private:
+        tVoid ProcessQueue();
+
+        cv::Mat AcquireOutputMat(tBool & bHit);
+        tVoid CountPoolUse(const cv::Mat & oPooled, tBool bHit, const cv::Mat & oResult);
+        tVoid UpdateStatistics(tBool bForce);
+        tVoid PublishLatencies(tBool bForce);
     };
 }
 }
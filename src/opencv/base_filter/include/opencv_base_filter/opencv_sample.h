@@ -42,6 +42,10 @@ class cOpenCVSample : public adtf::ucom::object<adtf::streaming::cSample, IOpenC
 {
 private: 
     cv::Mat m_oMat;
+    /// the sample owning the memory if m_oMat is only a header on top of it, released after the lock below
+    adtf::ucom::object_ptr<const adtf::streaming::ISample> m_pSource;
+    /// keeps the wrapped sample memory locked
+    adtf::ucom::object_ptr_shared_locked<const adtf::streaming::ISampleBuffer> m_pBuffer;
 public: 
     ADTF_CLASS_ID(cOpenCVSample, "sample.opencv.videotb.cid");
 
@@ -51,6 +55,16 @@ public:
 
     }
 
+    cOpenCVSample(const cv::Mat & oMat,
+        const adtf::ucom::iobject_ptr<const adtf::streaming::ISample>& pSource,
+        adtf::ucom::object_ptr_shared_locked<const adtf::streaming::ISampleBuffer> && pBuffer) :
+        m_oMat(oMat),
+        m_pSource(pSource),
+        m_pBuffer(std::move(pBuffer))
+    {
+
+    }
+
     const cv::Mat & GetMat() const override
     {
         return m_oMat;
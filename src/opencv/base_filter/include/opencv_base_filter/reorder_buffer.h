@@ -0,0 +1,69 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtf_streaming3.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Collects the results of samples processed concurrently and hands them on in
+ * the order of their sequence numbers, i.e. in the order the input samples arrived.
+ */
+class cReorderBuffer
+{
+public:
+    typedef std::function<tVoid(const adtf::ucom::object_ptr<const adtf::streaming::ISample>&)> tEmitFunction;
+
+public:
+    cReorderBuffer();
+
+    /// Drops all pending results, the next expected sequence number is nNextSequence.
+    tVoid Reset(tUInt64 nNextSequence = 0);
+
+    /**
+     * Stores the result for nSequence and calls fnEmit for every result which is in order now.
+     * fnEmit is called with the internal lock held, so the emitted samples are never interleaved.
+     * @param [in] pSample the result, an empty pointer marks a sample without output
+     */
+    tVoid Complete(tUInt64 nSequence,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pSample,
+        const tEmitFunction& fnEmit);
+
+    tSize GetPending() const;
+
+private:
+    mutable std::mutex m_oMutex;
+    std::map<tUInt64, adtf::ucom::object_ptr<const adtf::streaming::ISample>> m_mapPending;
+    tUInt64 m_nNextSequence = 0;
+};
+
+}
+}
+}
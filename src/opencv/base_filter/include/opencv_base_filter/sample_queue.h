@@ -0,0 +1,97 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtf_streaming3.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Bounded, thread safe FIFO of samples used to hand over samples from the
+ * trigger thread to the worker thread(s) of a filter.
+ */
+class cSampleQueue
+{
+public:
+    enum tOverflowPolicy : tInt32
+    {
+        OP_DropOldest = 0,
+        OP_DropNewest = 1,
+        OP_Block = 2
+    };
+
+public:
+    cSampleQueue();
+
+    tVoid Configure(tSize nCapacity, tOverflowPolicy eOverflowPolicy);
+
+    /**
+     * Appends a sample. If the queue is full the overflow policy decides whether the oldest
+     * or the new sample is dropped or the caller blocks until there is space again.
+     * @return tFalse if a sample had to be dropped or the queue is closed.
+     */
+    tBool Push(const adtf::ucom::iobject_ptr<const adtf::streaming::ISample>& pSample);
+
+    /**
+     * Takes the oldest sample out of the queue.
+     * @return tFalse if no sample arrived within tmTimeout or the queue is closed.
+     */
+    tBool Pop(adtf::ucom::object_ptr<const adtf::streaming::ISample>& pSample, std::chrono::milliseconds tmTimeout);
+
+    /**
+     * Same as above but additionally returns the position of the sample in the order the samples
+     * left the queue. Starts at 0 after Open.
+     */
+    tBool Pop(adtf::ucom::object_ptr<const adtf::streaming::ISample>& pSample, tUInt64 & nSequence, std::chrono::milliseconds tmTimeout);
+
+    /// Wakes up all blocked callers, further calls of Push and Pop fail until Open is called.
+    tVoid Close();
+    /// Reopens the queue and restarts the sequence numbering.
+    tVoid Open();
+    tVoid Clear();
+
+    tUInt64 GetDropped() const;
+
+private:
+    mutable std::mutex m_oMutex;
+    std::condition_variable m_oNotEmpty;
+    std::condition_variable m_oNotFull;
+    std::deque<adtf::ucom::object_ptr<const adtf::streaming::ISample>> m_oSamples;
+
+    tSize m_nCapacity = 1;
+    tOverflowPolicy m_eOverflowPolicy = OP_DropOldest;
+    tBool m_bClosed = tFalse;
+    tUInt64 m_nDropped = 0;
+    tUInt64 m_nNextSequence = 0;
+};
+
+}
+}
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtf_streaming3.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Bounded lock free ring for exactly one producer and one consumer thread.
+ * A full ring rejects new values, the producer can not drop the oldest one without racing the consumer.
+ */
+template <typename T>
+class cSpscRing
+{
+public:
+    explicit cSpscRing(tSize nCapacity = 16)
+    {
+        Reset(nCapacity);
+    }
+
+    /// Drops all values and changes the capacity. Only call it while neither producer nor consumer are running.
+    tVoid Reset(tSize nCapacity)
+    {
+        // one slot stays free to tell a full from an empty ring
+        m_vecSlots.assign(std::max<tSize>(nCapacity, 1) + 1, T());
+        m_nHead.store(0, std::memory_order_relaxed);
+        m_nTail.store(0, std::memory_order_relaxed);
+        m_nDropped.store(0, std::memory_order_relaxed);
+    }
+
+    /// Producer only. @return tFalse if the ring is full and the value was dropped.
+    tBool Push(T oValue)
+    {
+        const tSize nTail = m_nTail.load(std::memory_order_relaxed);
+        const tSize nNext = Next(nTail);
+        if (nNext == m_nHead.load(std::memory_order_acquire))
+        {
+            m_nDropped.fetch_add(1, std::memory_order_relaxed);
+            return tFalse;
+        }
+
+        m_vecSlots[nTail] = std::move(oValue);
+        m_nTail.store(nNext, std::memory_order_release);
+        return tTrue;
+    }
+
+    /// Consumer only. @return tFalse if the ring is empty.
+    tBool Pop(T& oValue)
+    {
+        const tSize nHead = m_nHead.load(std::memory_order_relaxed);
+        if (nHead == m_nTail.load(std::memory_order_acquire))
+        {
+            return tFalse;
+        }
+
+        // move out and release the slot content, so e.g. samples do not stay referenced by the ring
+        oValue = std::move(m_vecSlots[nHead]);
+        m_vecSlots[nHead] = T();
+        m_nHead.store(Next(nHead), std::memory_order_release);
+        return tTrue;
+    }
+
+    tUInt64 GetDropped() const
+    {
+        return m_nDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    tSize Next(tSize nIndex) const
+    {
+        return nIndex + 1 == m_vecSlots.size() ? 0 : nIndex + 1;
+    }
+
+private:
+    std::vector<T> m_vecSlots;
+    // head and tail are written by different threads, keep them on different cache lines
+    alignas(64) std::atomic<tSize> m_nHead;
+    alignas(64) std::atomic<tSize> m_nTail;
+    std::atomic<tUInt64> m_nDropped;
+};
+
+}
+}
+}
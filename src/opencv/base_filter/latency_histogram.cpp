@@ -0,0 +1,131 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <opencv_base_filter/latency_histogram.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+static tSize highest_bit(tUInt64 nValue)
+{
+#ifdef _MSC_VER
+    unsigned long nIndex = 0;
+    _BitScanReverse64(&nIndex, nValue);
+    return nIndex;
+#else
+    return 63 - __builtin_clzll(nValue);
+#endif
+}
+
+cLatencyHistogram::cLatencyHistogram()
+{
+    Reset();
+}
+
+tSize cLatencyHistogram::GetBucket(tUInt64 nValue)
+{
+    if (nValue < s_nSubBuckets)
+    {
+        return static_cast<tSize>(nValue);
+    }
+
+    // the highest bit selects the power of two, the next four bits the sub-bucket within it
+    const tSize nHighestBit = highest_bit(nValue);
+    const tSize nSubBucket = static_cast<tSize>(nValue >> (nHighestBit - 4)) & (s_nSubBuckets - 1);
+    return (nHighestBit - 3) * s_nSubBuckets + nSubBucket;
+}
+
+tUInt64 cLatencyHistogram::GetLowestValue(tSize nBucket)
+{
+    const tSize nExponent = nBucket / s_nSubBuckets;
+    const tUInt64 nSubBucket = nBucket % s_nSubBuckets;
+    return nExponent == 0 ? nSubBucket : (s_nSubBuckets + nSubBucket) << (nExponent - 1);
+}
+
+tVoid cLatencyHistogram::Record(tUInt64 nNanoseconds)
+{
+    m_arrBuckets[GetBucket(nNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+    tUInt64 nMax = m_nMax.load(std::memory_order_relaxed);
+    while (nNanoseconds > nMax && !m_nMax.compare_exchange_weak(nMax, nNanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+tUInt64 cLatencyHistogram::GetCount() const
+{
+    tUInt64 nCount = 0;
+    for (auto & nBucket : m_arrBuckets)
+    {
+        nCount += nBucket.load(std::memory_order_relaxed);
+    }
+    return nCount;
+}
+
+tUInt64 cLatencyHistogram::GetMax() const
+{
+    return m_nMax.load(std::memory_order_relaxed);
+}
+
+tUInt64 cLatencyHistogram::GetPercentile(tFloat64 fQuantile) const
+{
+    const tUInt64 nCount = GetCount();
+    if (nCount == 0)
+    {
+        return 0;
+    }
+
+    const tUInt64 nRank = std::max<tUInt64>(1, static_cast<tUInt64>(std::ceil(std::min(fQuantile, 1.0) * nCount)));
+    tUInt64 nSeen = 0;
+    for (tSize nBucket = 0; nBucket < s_nBuckets; ++nBucket)
+    {
+        nSeen += m_arrBuckets[nBucket].load(std::memory_order_relaxed);
+        if (nSeen >= nRank)
+        {
+            const tUInt64 nHighest = (nBucket + 1 < s_nBuckets) ? GetLowestValue(nBucket + 1) - 1 : UINT64_MAX;
+            return std::min(nHighest, GetMax());
+        }
+    }
+    return GetMax();
+}
+
+tVoid cLatencyHistogram::Reset()
+{
+    for (auto & nBucket : m_arrBuckets)
+    {
+        nBucket.store(0, std::memory_order_relaxed);
+    }
+    m_nMax.store(0, std::memory_order_relaxed);
+}
+
+}
+}
+}
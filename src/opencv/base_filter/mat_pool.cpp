@@ -0,0 +1,123 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <opencv_base_filter/mat_pool.h>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+static tBool is_unused(const cv::Mat & oMat)
+{
+    // the pool itself holds exactly one reference
+    return oMat.u && oMat.u->refcount == 1;
+}
+
+cMatPool::cMatPool(tSize nMaxBuffers) :
+    m_nMaxBuffers(nMaxBuffers)
+{
+}
+
+cv::Mat cMatPool::Acquire(tInt nRows, tInt nCols, tInt nType, tBool & bHit)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+
+    tKey oKey(nRows, nCols, nType);
+    auto & vecBuffers = m_mapBuffers[oKey];
+
+    for (auto & oBuffer : vecBuffers)
+    {
+        if (is_unused(oBuffer))
+        {
+            ++m_nHits;
+            bHit = tTrue;
+            return oBuffer;
+        }
+    }
+
+    ++m_nMisses;
+    bHit = tFalse;
+
+    if (m_nBufferCount >= m_nMaxBuffers && !EvictUnused(oKey))
+    {
+        // pool exhausted, every buffer is still in flight downstream
+        return cv::Mat(nRows, nCols, nType);
+    }
+
+    vecBuffers.emplace_back(nRows, nCols, nType);
+    ++m_nBufferCount;
+    return vecBuffers.back();
+}
+
+tBool cMatPool::EvictUnused(const tKey & oKeep)
+{
+    // buffers of an outdated geometry (e.g. after a format change) make room first
+    for (auto & oEntry : m_mapBuffers)
+    {
+        if (oEntry.first == oKeep)
+        {
+            continue;
+        }
+
+        auto & vecBuffers = oEntry.second;
+        for (auto itBuffer = vecBuffers.begin(); itBuffer != vecBuffers.end(); ++itBuffer)
+        {
+            if (is_unused(*itBuffer))
+            {
+                vecBuffers.erase(itBuffer);
+                --m_nBufferCount;
+                return tTrue;
+            }
+        }
+    }
+    return tFalse;
+}
+
+tVoid cMatPool::SetMaxBuffers(tSize nMaxBuffers)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_nMaxBuffers = nMaxBuffers;
+}
+
+tVoid cMatPool::Clear()
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    // buffers still referenced downstream stay valid, the pool only drops its own reference
+    m_mapBuffers.clear();
+    m_nBufferCount = 0;
+}
+
+tUInt64 cMatPool::GetHits() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_nHits;
+}
+
+tUInt64 cMatPool::GetMisses() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_nMisses;
+}
+
+}
+}
+}
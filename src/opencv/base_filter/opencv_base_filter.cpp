@@ -25,6 +25,7 @@ using namespace adtf::ucom;
 using namespace adtf::base;
 using namespace adtf::streaming;
 using namespace adtf::filter;
+using namespace adtf::system;
 
 using namespace cv::dnn;
 using namespace cv;
@@ -87,8 +88,56 @@ tResult check_stream_type(const Mat & oMat, tStreamImageFormat & oCurrentType, c
     RETURN_NOERROR;
 }
 
-cOpenCVBaseFilter::cOpenCVBaseFilter()
+tInt get_mat_type(const tStreamImageFormat & oImageFormat)
 {
+    if (oImageFormat.m_strFormatName == ADTF_IMAGE_FORMAT(RGB_24))
+    {
+        return CV_8UC3;
+    }
+    else if (oImageFormat.m_strFormatName == ADTF_IMAGE_FORMAT(GREYSCALE_8))
+    {
+        return CV_8UC1;
+    }
+    return -1;
+}
+
+cOpenCVBaseFilter::cOpenCVBaseFilter() :
+    m_nPoolHits(0),
+    m_nPoolMisses(0),
+    m_nStatisticsRequests(0),
+    m_bStatisticsDue(tFalse),
+    m_nLatencyFrames(0),
+    m_nNextLatencyDump(0)
+{
+    m_nMatPoolSize.SetDescription("Number of preallocated output buffers which are recycled once downstream released them. 0 disables the pool.");
+    RegisterPropertyVariable("mat_pool_size", m_nMatPoolSize);
+    set_property<tUInt64>(*this, "mat_pool_hits", 0);
+    set_property<tUInt64>(*this, "mat_pool_misses", 0);
+
+    m_bAsync.SetDescription("Process the samples in a dedicated worker thread. The trigger thread only queues the samples.");
+    RegisterPropertyVariable("async", m_bAsync);
+    m_nQueueSize.SetDescription("Maximum number of samples waiting for the worker thread.");
+    RegisterPropertyVariable("async_queue_size", m_nQueueSize);
+    m_nOverflowPolicy.SetDescription("What happens to a new sample if the queue of the worker thread is full.");
+    m_nOverflowPolicy.SetValueList({
+        {cSampleQueue::OP_DropOldest, "drop_oldest"},
+        {cSampleQueue::OP_DropNewest, "drop_newest"},
+        {cSampleQueue::OP_Block, "block"},
+        });
+    RegisterPropertyVariable("async_overflow_policy", m_nOverflowPolicy);
+    m_nWorkerThreads.SetDescription("Number of worker threads processing samples concurrently in async mode. "
+                                    "The output samples keep the input order. Only use more than one for stateless filters.");
+    RegisterPropertyVariable("async_worker_threads", m_nWorkerThreads);
+    set_property<tUInt64>(*this, "async_dropped", 0);
+
+    m_bLatencyHistograms.SetDescription("Record the duration of every processing stage in histograms and publish their percentiles. "
+                                        "Meant for profiling sessions, every interval logs one line per stage.");
+    RegisterPropertyVariable("latency_histograms", m_bLatencyHistograms);
+    m_nLatencyLogInterval.SetDescription("Interval in seconds the percentiles of the last interval are published and logged. 0 only publishes them on stop.");
+    RegisterPropertyVariable("latency_log_interval", m_nLatencyLogInterval);
+    m_nProcessStage = AddLatencyStage("process");
+    m_nWriteStage = AddLatencyStage("write");
+
     object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
     m_pOutput = CreateOutputPin("mat_out", pStreamType);
     m_pInput = CreateInputPin("mat_in", pStreamType);
@@ -96,6 +145,13 @@ cOpenCVBaseFilter::cOpenCVBaseFilter()
     {
         RETURN_IF_FAILED(get_stream_type_mat_format(m_sCurrentFormat, *pStreamType.Get()));
         m_sCurrentFormat = this->ConvertImageFormat(m_sCurrentFormat);
+        {
+            // the worker threads may still process samples of the previous format
+            std::lock_guard<std::mutex> oLock(m_oGeometryMutex);
+            m_sOutputGeometry.nRows = m_sCurrentFormat.m_ui32Height;
+            m_sOutputGeometry.nCols = m_sCurrentFormat.m_ui32Width;
+            m_sOutputGeometry.nType = get_mat_type(m_sCurrentFormat);
+        }
         object_ptr<IStreamType> pImageStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
         RETURN_IF_FAILED(set_stream_type_mat_format(*pImageStreamType.Get(), m_sCurrentFormat));
         RETURN_IF_FAILED(m_pOutput->ChangeType(pImageStreamType));
@@ -108,22 +164,235 @@ tStreamImageFormat cOpenCVBaseFilter::ConvertImageFormat(const tStreamImageForma
     return oImageFormat;
 }
 
+tResult cOpenCVBaseFilter::ProcessMat(const cv::Mat & oMat, cv::Mat & oResult)
+{
+    oResult = ProcessMat(oMat);
+    RETURN_NOERROR;
+}
+
+cv::Mat cOpenCVBaseFilter::ProcessMat(const cv::Mat & oMat)
+{
+    LOG_ERROR("The filter implements neither ProcessMat overload, no output is generated");
+    return cv::Mat();
+}
+
+cv::Mat cOpenCVBaseFilter::AcquireOutputMat(tBool & bHit)
+{
+    bHit = tFalse;
+    tOutputGeometry sGeometry;
+    {
+        std::lock_guard<std::mutex> oLock(m_oGeometryMutex);
+        sGeometry = m_sOutputGeometry;
+    }
+
+    if (m_nMatPoolSize <= 0 || sGeometry.nType < 0 || sGeometry.nCols == 0 || sGeometry.nRows == 0)
+    {
+        return cv::Mat();
+    }
+
+    return m_oMatPool.Acquire(sGeometry.nRows, sGeometry.nCols, sGeometry.nType, bHit);
+}
+
+tVoid cOpenCVBaseFilter::CountPoolUse(const cv::Mat & oPooled, tBool bHit, const cv::Mat & oResult)
+{
+    if (oPooled.empty() || oResult.empty())
+    {
+        return;
+    }
+
+    // the legacy ProcessMat overload and operations which reallocate return a different buffer
+    if (bHit && oResult.data == oPooled.data)
+    {
+        ++m_nPoolHits;
+    }
+    else
+    {
+        ++m_nPoolMisses;
+        m_bStatisticsDue = tTrue;
+    }
+}
+
+tVoid cOpenCVBaseFilter::UpdateStatistics(tBool bForce)
+{
+    // publishing properties is not for free, so only do it after a miss or every 100th sample
+    if (m_bStatisticsDue.exchange(tFalse) || ++m_nStatisticsRequests >= 100 || bForce)
+    {
+        m_nStatisticsRequests = 0;
+        set_property<tUInt64>(*this, "mat_pool_hits", m_nPoolHits);
+        set_property<tUInt64>(*this, "mat_pool_misses", m_nPoolMisses);
+        set_property<tUInt64>(*this, "async_dropped", m_oQueue.GetDropped());
+    }
+}
+
+tSize cOpenCVBaseFilter::AddLatencyStage(const cString & strName)
+{
+    m_vecLatencyStages.emplace_back(new cLatencyHistogram());
+    m_vecLatencyStageNames.push_back(strName);
+    return m_vecLatencyStages.size() - 1;
+}
+
+cLatencyHistogram* cOpenCVBaseFilter::GetLatencyStage(tSize nStage)
+{
+    return m_bLatencyHistograms ? m_vecLatencyStages[nStage].get() : nullptr;
+}
+
+tVoid cOpenCVBaseFilter::PublishLatencies(tBool bForce)
+{
+    // only look at the clock every 64 frames, the per frame overhead has to stay close to the timestamps themselves
+    if (!m_bLatencyHistograms || (!bForce && ((++m_nLatencyFrames & 63) != 0 || m_nLatencyLogInterval <= 0)))
+    {
+        return;
+    }
+
+    const tInt64 nNow = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    tInt64 nNextDump = m_nNextLatencyDump;
+    if (!bForce && (nNow < nNextDump ||
+        !m_nNextLatencyDump.compare_exchange_strong(nNextDump, nNow + static_cast<tInt64>(m_nLatencyLogInterval) * 1000000000)))
+    {
+        // not yet due
+        return;
+    }
+
+    for (tSize nStage = 0; nStage < m_vecLatencyStages.size(); ++nStage)
+    {
+        cLatencyHistogram & oHistogram = *m_vecLatencyStages[nStage];
+        const tUInt64 nCount = oHistogram.GetCount();
+        if (nCount == 0)
+        {
+            continue;
+        }
+
+        const cString & strName = m_vecLatencyStageNames[nStage];
+        const tFloat64 fP50 = oHistogram.GetPercentile(0.5) / 1000.0;
+        const tFloat64 fP99 = oHistogram.GetPercentile(0.99) / 1000.0;
+        const tFloat64 fP999 = oHistogram.GetPercentile(0.999) / 1000.0;
+        const tFloat64 fMax = oHistogram.GetMax() / 1000.0;
+        set_property<tFloat64>(*this, cString::Format("latency_%s_p50", strName.GetPtr()), fP50);
+        set_property<tFloat64>(*this, cString::Format("latency_%s_p99", strName.GetPtr()), fP99);
+        set_property<tFloat64>(*this, cString::Format("latency_%s_p999", strName.GetPtr()), fP999);
+        set_property<tFloat64>(*this, cString::Format("latency_%s_max", strName.GetPtr()), fMax);
+        LOG_INFO("%s latency of %s: n=%llu p50=%.1f p99=%.1f p999=%.1f max=%.1f us", get_named_graph_object_full_name(*this).GetPtr(), strName.GetPtr(),
+            static_cast<unsigned long long>(nCount), fP50, fP99, fP999, fMax);
+        oHistogram.Reset();
+    }
+}
+
 tResult cOpenCVBaseFilter::ProcessInput(ISampleReader* pReader,
     const iobject_ptr<const ISample>& pSample)
+{
+    if (m_bAsync)
+    {
+        if (!m_oQueue.Push(pSample))
+        {
+            LOG_DUMP("Worker queue full, sample dropped");
+        }
+        UpdateStatistics(tFalse);
+        PublishLatencies(tFalse);
+        RETURN_NOERROR;
+    }
+
+    cLatencyStopwatch oStopwatch(m_bLatencyHistograms);
+    object_ptr<const ISample> pOutSample;
+    RETURN_IF_FAILED(ProcessSample(pSample, pOutSample));
+    oStopwatch.Lap(GetLatencyStage(m_nProcessStage));
+    if (pOutSample)
+    {
+        m_pOutput->Write(pOutSample);
+        oStopwatch.Lap(GetLatencyStage(m_nWriteStage));
+    }
+    UpdateStatistics(tFalse);
+    PublishLatencies(tFalse);
+    RETURN_NOERROR;
+}
+
+tResult cOpenCVBaseFilter::ProcessSample(const iobject_ptr<const ISample>& pSample, object_ptr<const ISample>& pOutSample)
 {
     object_ptr<const IOpenCVSample> pMatSample = pSample;
     if (pMatSample)
     {
-        cv::Mat oMat = ProcessMat(pMatSample->GetMat());
+        tBool bHit = tFalse;
+        cv::Mat oMat = AcquireOutputMat(bHit);
+        const cv::Mat oPooled = oMat;
+        RETURN_IF_FAILED(ProcessMat(pMatSample->GetMat(), oMat));
+        CountPoolUse(oPooled, bHit, oMat);
         if (!oMat.empty())
         {
-            object_ptr<ISample> pSample = make_object_ptr<cOpenCVSample>(oMat);
-            m_pOutput->Write(pSample);
+            object_ptr<ISample> pNewSample = make_object_ptr<cOpenCVSample>(oMat);
+            pNewSample->SetTime(pSample->GetTime());
+            pOutSample = pNewSample;
         }
     }
     RETURN_NOERROR;
 }
 
+tVoid cOpenCVBaseFilter::ProcessQueue()
+{
+    object_ptr<const ISample> pSample;
+    tUInt64 nSequence = 0;
+    if (m_oQueue.Pop(pSample, nSequence, std::chrono::milliseconds(100)))
+    {
+        cLatencyStopwatch oStopwatch(m_bLatencyHistograms);
+        object_ptr<const ISample> pOutSample;
+        if (IS_FAILED(ProcessSample(pSample, pOutSample)))
+        {
+            LOG_ERROR("Processing of sample in worker thread failed");
+        }
+        oStopwatch.Lap(GetLatencyStage(m_nProcessStage));
+
+        // every sequence number has to be completed, even without output, otherwise the following ones would stall
+        m_oReorderBuffer.Complete(nSequence, pOutSample, [this](const object_ptr<const ISample>& pOrderedSample)
+        {
+            m_pOutput->Write(pOrderedSample);
+            // we are not running within a trigger, so the samples need to be pushed downstream
+            m_pOutput->ManualTrigger();
+        });
+        // includes the samples of other workers released by the reorder buffer
+        oStopwatch.Lap(GetLatencyStage(m_nWriteStage));
+    }
+}
+
+tResult cOpenCVBaseFilter::Start()
+{
+    RETURN_IF_FAILED(cFilter::Start());
+
+    m_nLatencyFrames = 0;
+    m_nNextLatencyDump = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() +
+        static_cast<tInt64>(m_nLatencyLogInterval) * 1000000000;
+
+    if (m_bAsync)
+    {
+        m_oQueue.Configure(std::max<tInt32>(m_nQueueSize, 1),
+            static_cast<cSampleQueue::tOverflowPolicy>(static_cast<tInt32>(m_nOverflowPolicy)));
+        m_oQueue.Open();
+        m_oReorderBuffer.Reset();
+
+        for (tInt32 nWorker = 0; nWorker < std::max<tInt32>(m_nWorkerThreads, 1); ++nWorker)
+        {
+            m_vecWorkers.emplace_back(cString::Format("%s::process_%d", get_named_graph_object_full_name(*this).GetPtr(), nWorker),
+                &cOpenCVBaseFilter::ProcessQueue, this);
+            if (!m_vecWorkers.back().Joinable())
+            {
+                RETURN_ERROR_DESC(ERR_UNEXPECTED, "Unable to create worker thread %d", nWorker);
+            }
+        }
+    }
+
+    RETURN_NOERROR;
+}
+
+tResult cOpenCVBaseFilter::Stop()
+{
+    // wake up a blocked trigger thread and the worker before joining it
+    m_oQueue.Close();
+    m_vecWorkers.clear();
+    m_oQueue.Clear();
+    m_oReorderBuffer.Reset();
+    UpdateStatistics(tTrue);
+    PublishLatencies(tTrue);
+
+    return cFilter::Stop();
+}
+
 tResult cOpenCVBaseFilter::Init(tInitStage eStage)
 {
     RETURN_IF_FAILED(cFilter::Init(eStage));
@@ -137,6 +406,7 @@ tResult cOpenCVBaseFilter::Init(tInitStage eStage)
     break;
     case tInitStage::StagePreConnect:
     {
+        m_oMatPool.SetMaxBuffers(std::max<tInt32>(m_nMatPoolSize, 0));
         RETURN_IF_FAILED(OnStagePreConnect());
     }
     break;
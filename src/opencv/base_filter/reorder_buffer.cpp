@@ -0,0 +1,75 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <opencv_base_filter/reorder_buffer.h>
+
+using namespace adtf::ucom;
+using namespace adtf::streaming;
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+cReorderBuffer::cReorderBuffer()
+{
+}
+
+tVoid cReorderBuffer::Reset(tUInt64 nNextSequence)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_mapPending.clear();
+    m_nNextSequence = nNextSequence;
+}
+
+tVoid cReorderBuffer::Complete(tUInt64 nSequence, const object_ptr<const ISample>& pSample, const tEmitFunction& fnEmit)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+
+    if (nSequence < m_nNextSequence)
+    {
+        // outdated result of a previous run
+        return;
+    }
+
+    m_mapPending[nSequence] = pSample;
+
+    for (auto itPending = m_mapPending.begin();
+         itPending != m_mapPending.end() && itPending->first == m_nNextSequence;
+         itPending = m_mapPending.erase(itPending))
+    {
+        if (itPending->second)
+        {
+            fnEmit(itPending->second);
+        }
+        ++m_nNextSequence;
+    }
+}
+
+tSize cReorderBuffer::GetPending() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_mapPending.size();
+}
+
+}
+}
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <opencv_base_filter/sample_queue.h>
+
+using namespace adtf::ucom;
+using namespace adtf::streaming;
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+cSampleQueue::cSampleQueue()
+{
+}
+
+tVoid cSampleQueue::Configure(tSize nCapacity, tOverflowPolicy eOverflowPolicy)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_nCapacity = nCapacity > 0 ? nCapacity : 1;
+    m_eOverflowPolicy = eOverflowPolicy;
+}
+
+tBool cSampleQueue::Push(const iobject_ptr<const ISample>& pSample)
+{
+    std::unique_lock<std::mutex> oLock(m_oMutex);
+
+    if (m_bClosed)
+    {
+        return tFalse;
+    }
+
+    tBool bDropped = tFalse;
+    if (m_oSamples.size() >= m_nCapacity)
+    {
+        switch (m_eOverflowPolicy)
+        {
+        case OP_DropNewest:
+        {
+            ++m_nDropped;
+            return tFalse;
+        }
+        case OP_Block:
+        {
+            m_oNotFull.wait(oLock, [this] { return m_bClosed || m_oSamples.size() < m_nCapacity; });
+            if (m_bClosed)
+            {
+                return tFalse;
+            }
+        }
+        break;
+        case OP_DropOldest:
+        default:
+        {
+            m_oSamples.pop_front();
+            ++m_nDropped;
+            bDropped = tTrue;
+        }
+        break;
+        }
+    }
+
+    m_oSamples.emplace_back(pSample);
+    oLock.unlock();
+    m_oNotEmpty.notify_one();
+
+    return !bDropped;
+}
+
+tBool cSampleQueue::Pop(object_ptr<const ISample>& pSample, std::chrono::milliseconds tmTimeout)
+{
+    tUInt64 nSequence;
+    return Pop(pSample, nSequence, tmTimeout);
+}
+
+tBool cSampleQueue::Pop(object_ptr<const ISample>& pSample, tUInt64 & nSequence, std::chrono::milliseconds tmTimeout)
+{
+    std::unique_lock<std::mutex> oLock(m_oMutex);
+
+    if (!m_oNotEmpty.wait_for(oLock, tmTimeout, [this] { return m_bClosed || !m_oSamples.empty(); }) ||
+        m_bClosed)
+    {
+        return tFalse;
+    }
+
+    pSample = m_oSamples.front();
+    m_oSamples.pop_front();
+    nSequence = m_nNextSequence++;
+    oLock.unlock();
+    m_oNotFull.notify_one();
+
+    return tTrue;
+}
+
+tVoid cSampleQueue::Close()
+{
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_bClosed = tTrue;
+    }
+    m_oNotEmpty.notify_all();
+    m_oNotFull.notify_all();
+}
+
+tVoid cSampleQueue::Open()
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_bClosed = tFalse;
+    m_nNextSequence = 0;
+}
+
+tVoid cSampleQueue::Clear()
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_oSamples.clear();
+}
+
+tUInt64 cSampleQueue::GetDropped() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_nDropped;
+}
+
+}
+}
+}
@@ -0,0 +1,404 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <adtftesting/adtf_testing.h>
+#include <adtffiltersdk/adtf_filtersdk.h>
+
+#include <opencv_base_filter/mat_pool.h>
+#include <opencv_base_filter/sample_queue.h>
+#include <opencv_base_filter/reorder_buffer.h>
+#include <opencv_base_filter/latency_histogram.h>
+#include <opencv_base_filter/spsc_ring.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace adtf::ucom;
+using namespace adtf::streaming;
+using namespace adtf::videotb::opencv;
+
+static object_ptr<const ISample> create_sample(tTimeStamp tmTime)
+{
+    object_ptr<ISample> pSample = make_object_ptr<cSample>();
+    pSample->SetTime(tmTime);
+    return pSample;
+}
+
+TEST_CASE("mat pool reuses released buffers")
+{
+    cMatPool oPool(2);
+    tBool bHit = tFalse;
+
+    const uchar* pData = nullptr;
+    {
+        cv::Mat oFirst = oPool.Acquire(4, 4, CV_8UC1, bHit);
+        REQUIRE_FALSE(bHit);
+        pData = oFirst.data;
+    }
+
+    cv::Mat oReused = oPool.Acquire(4, 4, CV_8UC1, bHit);
+    REQUIRE(bHit);
+    REQUIRE(oReused.data == pData);
+
+    // the reused buffer is still referenced, so a second one is pooled
+    cv::Mat oSecond = oPool.Acquire(4, 4, CV_8UC1, bHit);
+    REQUIRE_FALSE(bHit);
+    REQUIRE(oSecond.data != pData);
+
+    // the pool is exhausted, the caller gets an unpooled buffer
+    cv::Mat oUnpooled = oPool.Acquire(4, 4, CV_8UC1, bHit);
+    REQUIRE_FALSE(bHit);
+    REQUIRE(oUnpooled.data != oReused.data);
+    REQUIRE(oUnpooled.data != oSecond.data);
+    const uchar* pUnpooled = oUnpooled.data;
+    oUnpooled.release();
+
+    oSecond.release();
+    cv::Mat oAgain = oPool.Acquire(4, 4, CV_8UC1, bHit);
+    REQUIRE(bHit);
+    REQUIRE(oAgain.data != pUnpooled);
+
+    REQUIRE(oPool.GetHits() == 2);
+    REQUIRE(oPool.GetMisses() == 3);
+}
+
+TEST_CASE("mat pool evicts buffers of an outdated geometry")
+{
+    cMatPool oPool(1);
+    tBool bHit = tFalse;
+
+    oPool.Acquire(4, 4, CV_8UC1, bHit);
+
+    // the unused 4x4 buffer makes room for the new geometry
+    const uchar* pData = nullptr;
+    {
+        cv::Mat oLarge = oPool.Acquire(8, 8, CV_8UC1, bHit);
+        REQUIRE_FALSE(bHit);
+        pData = oLarge.data;
+    }
+
+    cv::Mat oReused = oPool.Acquire(8, 8, CV_8UC1, bHit);
+    REQUIRE(bHit);
+    REQUIRE(oReused.data == pData);
+
+    // a buffer still referenced is never evicted
+    cv::Mat oOther = oPool.Acquire(2, 2, CV_8UC1, bHit);
+    REQUIRE_FALSE(bHit);
+    REQUIRE(oPool.Acquire(8, 8, CV_8UC1, bHit).data != pData);
+    REQUIRE_FALSE(bHit);
+}
+
+TEST_CASE("sample queue overflow policies")
+{
+    cSampleQueue oQueue;
+    object_ptr<const ISample> pSample;
+
+    SECTION("drop oldest")
+    {
+        oQueue.Configure(2, cSampleQueue::OP_DropOldest);
+        REQUIRE(oQueue.Push(create_sample(1)));
+        REQUIRE(oQueue.Push(create_sample(2)));
+        REQUIRE_FALSE(oQueue.Push(create_sample(3)));
+        REQUIRE(oQueue.GetDropped() == 1);
+
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+        REQUIRE(pSample->GetTime() == 2);
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+        REQUIRE(pSample->GetTime() == 3);
+        REQUIRE_FALSE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+    }
+
+    SECTION("drop newest")
+    {
+        oQueue.Configure(2, cSampleQueue::OP_DropNewest);
+        REQUIRE(oQueue.Push(create_sample(1)));
+        REQUIRE(oQueue.Push(create_sample(2)));
+        REQUIRE_FALSE(oQueue.Push(create_sample(3)));
+        REQUIRE(oQueue.GetDropped() == 1);
+
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+        REQUIRE(pSample->GetTime() == 1);
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+        REQUIRE(pSample->GetTime() == 2);
+    }
+
+    SECTION("block")
+    {
+        oQueue.Configure(1, cSampleQueue::OP_Block);
+        REQUIRE(oQueue.Push(create_sample(1)));
+
+        std::thread oProducer([&oQueue]
+        {
+            oQueue.Push(create_sample(2));
+        });
+
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(1000)));
+        REQUIRE(pSample->GetTime() == 1);
+        REQUIRE(oQueue.Pop(pSample, std::chrono::milliseconds(1000)));
+        REQUIRE(pSample->GetTime() == 2);
+        oProducer.join();
+        REQUIRE(oQueue.GetDropped() == 0);
+    }
+
+    SECTION("close wakes up a blocked producer")
+    {
+        oQueue.Configure(1, cSampleQueue::OP_Block);
+        REQUIRE(oQueue.Push(create_sample(1)));
+
+        tBool bPushed = tTrue;
+        std::thread oProducer([&oQueue, &bPushed]
+        {
+            bPushed = oQueue.Push(create_sample(2));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        oQueue.Close();
+        oProducer.join();
+
+        REQUIRE_FALSE(bPushed);
+        REQUIRE_FALSE(oQueue.Pop(pSample, std::chrono::milliseconds(0)));
+    }
+}
+
+TEST_CASE("sample queue numbers the samples in the order they leave")
+{
+    cSampleQueue oQueue;
+    oQueue.Configure(4, cSampleQueue::OP_DropOldest);
+    object_ptr<const ISample> pSample;
+    tUInt64 nSequence = 0;
+
+    oQueue.Push(create_sample(1));
+    oQueue.Push(create_sample(2));
+    REQUIRE(oQueue.Pop(pSample, nSequence, std::chrono::milliseconds(0)));
+    REQUIRE(nSequence == 0);
+    REQUIRE(oQueue.Pop(pSample, nSequence, std::chrono::milliseconds(0)));
+    REQUIRE(nSequence == 1);
+
+    // a restart begins with 0 again
+    oQueue.Close();
+    oQueue.Open();
+    oQueue.Push(create_sample(3));
+    REQUIRE(oQueue.Pop(pSample, nSequence, std::chrono::milliseconds(0)));
+    REQUIRE(nSequence == 0);
+}
+
+TEST_CASE("reorder buffer emits out of order completions in order")
+{
+    cReorderBuffer oReorder;
+    std::vector<tTimeStamp> vecEmitted;
+    auto fnEmit = [&vecEmitted](const object_ptr<const ISample>& pSample)
+    {
+        vecEmitted.push_back(pSample->GetTime());
+    };
+
+    oReorder.Complete(2, create_sample(2), fnEmit);
+    oReorder.Complete(1, create_sample(1), fnEmit);
+    REQUIRE(vecEmitted.empty());
+    REQUIRE(oReorder.GetPending() == 2);
+
+    oReorder.Complete(0, create_sample(0), fnEmit);
+    REQUIRE(vecEmitted == std::vector<tTimeStamp>({ 0, 1, 2 }));
+    REQUIRE(oReorder.GetPending() == 0);
+
+    // a sample without output does not block the ones after it
+    oReorder.Complete(4, create_sample(4), fnEmit);
+    oReorder.Complete(3, object_ptr<const ISample>(), fnEmit);
+    REQUIRE(vecEmitted == std::vector<tTimeStamp>({ 0, 1, 2, 4 }));
+
+    // results of a previous run are ignored
+    oReorder.Reset(10);
+    oReorder.Complete(5, create_sample(5), fnEmit);
+    REQUIRE(oReorder.GetPending() == 0);
+    oReorder.Complete(10, create_sample(10), fnEmit);
+    REQUIRE(vecEmitted.back() == 10);
+}
+
+TEST_CASE("reorder buffer keeps the order with concurrent workers")
+{
+    cReorderBuffer oReorder;
+    std::vector<tTimeStamp> vecEmitted;
+    auto fnEmit = [&vecEmitted](const object_ptr<const ISample>& pSample)
+    {
+        // called with the lock of the buffer held
+        vecEmitted.push_back(pSample->GetTime());
+    };
+
+    const tUInt64 nSamples = 1000;
+    const tUInt64 nWorkers = 4;
+    std::vector<std::thread> vecWorkers;
+    for (tUInt64 nWorker = 0; nWorker < nWorkers; ++nWorker)
+    {
+        vecWorkers.emplace_back([&oReorder, &fnEmit, nWorker, nSamples, nWorkers]
+        {
+            for (tUInt64 nSequence = nWorker; nSequence < nSamples; nSequence += nWorkers)
+            {
+                oReorder.Complete(nSequence, create_sample(static_cast<tTimeStamp>(nSequence)), fnEmit);
+            }
+        });
+    }
+    for (auto & oWorker : vecWorkers)
+    {
+        oWorker.join();
+    }
+
+    REQUIRE(vecEmitted.size() == nSamples);
+    for (tSize nIndex = 0; nIndex < vecEmitted.size(); ++nIndex)
+    {
+        REQUIRE(vecEmitted[nIndex] == static_cast<tTimeStamp>(nIndex));
+    }
+}
+
+TEST_CASE("latency histogram bucket bounds")
+{
+    cLatencyHistogram oHistogram;
+    REQUIRE(oHistogram.GetCount() == 0);
+    REQUIRE(oHistogram.GetPercentile(0.5) == 0);
+
+    // small values have a bucket of their own
+    for (tUInt64 nValue = 0; nValue < 16; ++nValue)
+    {
+        oHistogram.Reset();
+        oHistogram.Record(nValue);
+        oHistogram.Record(1000000);
+        REQUIRE(oHistogram.GetPercentile(0.5) == nValue);
+    }
+
+    // larger ones are reported with the upper bound of their bucket, at most 1/16 above
+    for (tUInt64 nValue : { 16ULL, 17ULL, 31ULL, 32ULL, 100ULL, 1000ULL, 123456789ULL, 1ULL << 40 })
+    {
+        oHistogram.Reset();
+        oHistogram.Record(nValue);
+        oHistogram.Record(UINT64_MAX);
+        const tUInt64 nPercentile = oHistogram.GetPercentile(0.5);
+        REQUIRE(nPercentile >= nValue);
+        REQUIRE(nPercentile <= nValue + nValue / 16);
+    }
+
+    // a single value is never reported above the maximum
+    oHistogram.Reset();
+    oHistogram.Record(1000);
+    REQUIRE(oHistogram.GetPercentile(1.0) == 1000);
+    REQUIRE(oHistogram.GetMax() == 1000);
+}
+
+TEST_CASE("latency histogram percentiles")
+{
+    cLatencyHistogram oHistogram;
+    for (tUInt64 nValue = 1; nValue <= 1000; ++nValue)
+    {
+        oHistogram.Record(nValue * 1000);
+    }
+
+    REQUIRE(oHistogram.GetCount() == 1000);
+    REQUIRE(oHistogram.GetMax() == 1000000);
+
+    const tUInt64 nMedian = oHistogram.GetPercentile(0.5);
+    REQUIRE(nMedian >= 500000);
+    REQUIRE(nMedian <= 500000 + 500000 / 16);
+
+    const tUInt64 nP99 = oHistogram.GetPercentile(0.99);
+    REQUIRE(nP99 >= 990000);
+    REQUIRE(nP99 <= 1000000);
+
+    oHistogram.Reset();
+    REQUIRE(oHistogram.GetCount() == 0);
+    REQUIRE(oHistogram.GetMax() == 0);
+}
+
+TEST_CASE("spsc ring rejects values when full")
+{
+    cSpscRing<tInt32> oRing(3);
+    REQUIRE(oRing.Push(1));
+    REQUIRE(oRing.Push(2));
+    REQUIRE(oRing.Push(3));
+    REQUIRE_FALSE(oRing.Push(4));
+    REQUIRE(oRing.GetDropped() == 1);
+
+    tInt32 nValue = 0;
+    REQUIRE(oRing.Pop(nValue));
+    REQUIRE(nValue == 1);
+
+    // wraps around
+    REQUIRE(oRing.Push(5));
+    for (tInt32 nExpected : { 2, 3, 5 })
+    {
+        REQUIRE(oRing.Pop(nValue));
+        REQUIRE(nValue == nExpected);
+    }
+    REQUIRE_FALSE(oRing.Pop(nValue));
+
+    oRing.Reset(1);
+    REQUIRE(oRing.GetDropped() == 0);
+    REQUIRE(oRing.Push(6));
+    REQUIRE_FALSE(oRing.Push(7));
+}
+
+TEST_CASE("spsc ring releases the popped values")
+{
+    cSpscRing<cv::Mat> oRing(2);
+    cv::Mat oBuffer(4, 4, CV_8UC1);
+    REQUIRE(oRing.Push(oBuffer));
+
+    cv::Mat oPopped;
+    REQUIRE(oRing.Pop(oPopped));
+    oPopped.release();
+    // the ring holds no reference any more, e.g. the buffer can return to a cMatPool
+    REQUIRE(oBuffer.u->refcount == 1);
+}
+
+TEST_CASE("spsc ring keeps the order between two threads")
+{
+    cSpscRing<tUInt64> oRing(16);
+    const tUInt64 nValues = 100000;
+
+    std::thread oProducer([&oRing, nValues]
+    {
+        for (tUInt64 nValue = 0; nValue < nValues;)
+        {
+            if (oRing.Push(nValue))
+            {
+                ++nValue;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    tUInt64 nExpected = 0;
+    tBool bInOrder = tTrue;
+    while (nExpected < nValues)
+    {
+        tUInt64 nValue = 0;
+        if (oRing.Pop(nValue))
+        {
+            bInOrder = bInOrder && nValue == nExpected;
+            ++nExpected;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    oProducer.join();
+
+    REQUIRE(bInOrder);
+}
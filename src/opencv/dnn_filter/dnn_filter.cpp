@@ -24,9 +24,18 @@
 
 #include <opencv_base_filter/opencv_sample.h>
 #include <opencv_base_filter/opencv_base_filter.h>
+#include <opencv_base_filter/detection.h>
+#include <opencv_base_filter/spsc_ring.h>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
+#include <opencv2/dnn/shape_utils.hpp>
+
+#include "dnn_preprocess.h"
+#include "dnn_postprocess.h"
+#include "dnn_pipeline.h"
+#include "dnn_motion.h"
+#include "dnn_model_cache.h"
 
 using namespace adtf::util;
 using namespace adtf::ucom;
@@ -51,7 +60,7 @@ public:
     property_variable<cFilename> m_strModule;
     property_variable<cFilename> m_strConfig;
 
-    property_variable<tFloat32> m_fBlobScale = 1.0;
+    property_variable<tFloat32> m_fBlobScale = 1.0 / 255.0;
     property_variable<tFloat32> m_fBlobMeanRed = 0.0;
     property_variable<tFloat32> m_fBlobMeanGreen = 0.0;
     property_variable<tFloat32> m_fBlobMeanBlue = 0.0;
@@ -59,15 +68,169 @@ public:
     property_variable<tInt32> m_fBlobWidth = 224;
     property_variable<tInt32> m_fBlobHeight = 224;
 
-    Net m_oDnnNet;
-    std::vector<std::string> m_vecOutputLayerNames;
+    property_variable<tBool> m_bBlobLetterbox = tFalse;
+
+    std::vector<String> m_vecOutputLayerNames;
+    std::vector<String> m_vecOutputLayerTypes;
+
+    property_variable<tFloat32> m_fDetectionThreshold = 0.25f;
 
     property_variable<tInt32> m_nBackend = 0;
     property_variable<tInt32> m_nTarget = 0;
 
+    property_variable<tInt32> m_nBatchSize = 1;
+    property_variable<tInt32> m_nBatchTimeout = 50;
+    property_variable<tInt32> m_nBatchInputs = 1;
+
+    struct tBatchEntry
+    {
+        tSize nInput;
+        object_ptr<const ISample> pSample;
+        /// region of the frame which is inferred, empty for the whole frame
+        Rect oRoi;
+        /// a frame split into tiles is inferred as nParts consecutive entries, 0 if it is not split
+        tSize nPart;
+        tSize nParts;
+        /// position of the frame in the detections of its input, all parts of a frame share it
+        tUInt64 nSequence;
+    };
+
+    // index 0 are the pins of the base filter, the others are the additional camera inputs
+    std::vector<cPinReader*> m_vecBatchInputs;
+    std::vector<cPinWriter*> m_vecBatchOutputs;
+    std::vector<cPinWriter*> m_vecDetectionOutputs;
+    std::vector<cPinWriter*> m_vecMotionOutputs;
+    // one per input, keeps the detections of inferred and skipped frames in order
+    std::vector<std::unique_ptr<cDetectionSequencer>> m_vecSequencers;
+
+    std::mutex m_oBatchMutex;
+    std::condition_variable m_oBatchCondition;
+    std::vector<tBatchEntry> m_vecBatch;
+    std::chrono::steady_clock::time_point m_tmBatchDeadline;
+    kernel_thread_looper m_oBatchTimer;
+
+    /// One inference in flight: the frames, their blob and the outputs of the net.
+    struct tRequest
+    {
+        std::vector<tBatchEntry> vecEntries;
+        Mat oBlob;
+        // the images of the blob from this index on are zero
+        int nPaddedFrom = 0;
+        std::vector<tBlobGeometry> vecGeometry;
+        std::vector<Mat> vecOuts;
+        AsyncArray oAsyncOutput;
+        std::vector<Mat> vecResults;
+        std::vector<std::vector<tDetection>> vecDetections;
+        // set by the forward thread of the instance, guarded by m_oForwardedMutex
+        tBool bForwarded = tFalse;
+        std::chrono::steady_clock::time_point tmForwardStart;
+    };
+
+    /// One copy of the net with its own forward thread. Index 0 is used by the synchronous path as well.
+    struct tNetInstance
+    {
+        // shared with other filters if the model cache service is running
+        std::shared_ptr<tSharedNet> pNet = std::make_shared<tSharedNet>();
+        // belong to the net and are overwritten by the next forward call
+        std::vector<Mat> vecOuts;
+        cRequestChannel<tRequest*> oRequests;
+        kernel_thread_looper oThread;
+        std::atomic<tInt32> nInFlight{ 0 };
+    };
+
+    enum tDispatch : tInt32
+    {
+        DP_RoundRobin = 0,
+        DP_LeastLoaded = 1
+    };
+
+    property_variable<tInt32> m_nNetInstances = 1;
+    property_variable<tInt32> m_nDispatch = DP_RoundRobin;
+    property_variable<tInt32> m_nThreadsPerInstance = 0;
+    property_variable<tBool> m_bSharedModelCache = tFalse;
+    tBool m_bSharedNets = tFalse;
+
+    property_variable<tInt32> m_nPrecision = PR_FP32;
+    property_variable<cFilename> m_strQuantizedModule;
+    property_variable<cFilename> m_strCalibrationImage;
+    property_variable<tBool> m_bPrecisionCompare = tFalse;
+    property_variable<tInt32> m_nPrecisionCompareInterval = 30;
+    // full precision copy of the net, only loaded for the comparison
+    std::shared_ptr<tSharedNet> m_pReferenceNet;
+    std::atomic<tUInt32> m_nCompareCounter;
+    std::vector<std::unique_ptr<tNetInstance>> m_vecNets;
+    std::atomic<tUInt32> m_nNextInstance;
+
+    // latency histograms of the pipeline stages, see cOpenCVBaseFilter::AddLatencyStage
+    tSize m_nPreprocessStage;
+    tSize m_nForwardStage;
+    tSize m_nDecodeStage;
+    tSize m_nEmitStage;
+
+    property_variable<tInt32> m_nPipelineDepth = 1;
+    // buffers reused for every frame, allocated in OnStagePreConnect, they only depend on the blob size
+    // without pipelining only the first request is used
+    std::vector<tRequest> m_vecRequests;
+    cRequestChannel<tRequest*> m_oFreeRequests;
+    cRequestChannel<tRequest*> m_oDecodeRequests;
+    kernel_thread_looper m_oDecodeThread;
+    std::mutex m_oForwardedMutex;
+    std::condition_variable m_oForwardedCondition;
+    tBool m_bForwardAsync = tFalse;
+
+    property_variable<tBool> m_bGovernor = tFalse;
+    property_variable<tFloat32> m_fMinDetectionRate = 1.0f;
+    property_variable<tBool> m_bSkipPassThrough = tTrue;
+
+    std::mutex m_oGovernorMutex;
+    // smoothed duration of one forward call in seconds, 0 until the first one finished
+    tFloat64 m_fForwardLatency = 0.0;
+    std::vector<std::chrono::steady_clock::time_point> m_vecLastAdmitted;
+    tUInt64 m_nSkippedFrames = 0;
+
+    property_variable<tBool> m_bMotionGating = tFalse;
+    property_variable<tBool> m_bMotionRoi = tTrue;
+    property_variable<tInt32> m_nMotionWidth = 160;
+    property_variable<tFloat32> m_fMotionThreshold = 25.0f;
+    property_variable<tFloat32> m_fMotionMinArea = 0.001f;
+    property_variable<tFloat32> m_fMotionLearningRate = 0.05f;
+    // one per input, only used by the trigger thread of the input
+    std::vector<cMotionDetector> m_vecMotionDetectors;
+
+    property_variable<tBool> m_bTiling = tFalse;
+    property_variable<tInt32> m_nTileSize = 640;
+    property_variable<tInt32> m_nTileOverlap = 64;
+    property_variable<tBool> m_bTileFullFrame = tTrue;
+    property_variable<tFloat32> m_fTileNmsThreshold = 0.5f;
+
+    enum tNotReadyPolicy : tInt32
+    {
+        NR_EmptyDetections = 0,
+        NR_Drop = 1
+    };
+
+    property_variable<tBool> m_bBackgroundLoad = tTrue;
+    property_variable<tInt32> m_nNotReadyPolicy = NR_EmptyDetections;
+    property_variable<tInt32> m_nWarmupIterations = 1;
+    kernel_thread m_oLoadThread;
+    // set once the nets are loaded and warmed up, the layer information below is read only afterwards
+    std::atomic<tBool> m_bNetReady;
+
+    Mat m_oImInfo;
+    cMatPool m_oOutputPool;
+    property_variable<tInt32> m_nOutputPoolSize = 4;
+
+    tBool m_bImInfo = tFalse;
+
+    std::atomic<tUInt64> m_nAllocations;
+
 public:
     
-    cDNNOpenCVFilter()
+    cDNNOpenCVFilter() :
+        m_nNextInstance(0),
+        m_nCompareCounter(0),
+        m_bNetReady(tFalse),
+        m_nAllocations(0)
     {
         SetDescription("OpenCV DNN Filter");
 
@@ -82,6 +245,9 @@ public:
         RegisterPropertyVariable("blob_input_width", m_fBlobWidth);
         RegisterPropertyVariable("blob_input_height", m_fBlobHeight);
 
+        m_bBlobLetterbox.SetDescription("Keep the aspect ratio of the image and pad the remaining blob area with grey (114).");
+        RegisterPropertyVariable("blob_letterbox", m_bBlobLetterbox);
+
         m_nBackend.SetDescription("Enum of computation backends supported by layers.");
         m_nBackend.SetValueList({
             {cv::dnn::DNN_BACKEND_DEFAULT, "DNN_BACKEND_DEFAULT"},
@@ -107,219 +273,1840 @@ public:
             });
 
         RegisterPropertyVariable("target", m_nTarget);
+
+        m_fDetectionThreshold.SetDescription("Minimum score of the detections sent on the detections pin.");
+        RegisterPropertyVariable("detection_threshold", m_fDetectionThreshold);
+
+        m_nBatchSize.SetDescription("Number of frames forwarded through the net at once.");
+        RegisterPropertyVariable("batch_size", m_nBatchSize);
+        m_nBatchTimeout.SetDescription("Maximum time in ms the first frame of an incomplete batch waits for the others.");
+        RegisterPropertyVariable("batch_timeout", m_nBatchTimeout);
+        m_nBatchInputs.SetDescription("Number of input pins (cameras) sharing the batches. "
+                                      "Pins mat_in_<n> and mat_out_<n> are created for every additional input.");
+        RegisterPropertyVariable("batch_inputs", m_nBatchInputs);
+
+        m_nPipelineDepth.SetDescription("Number of frames in flight. With more than one the next frame is preprocessed in the trigger thread "
+                                        "while the current one is forwarded and the previous one is decoded in dedicated threads. "
+                                        "The results keep the input order. Uses forwardAsync on the Inference Engine backend.");
+        RegisterPropertyVariable("pipeline_depth", m_nPipelineDepth);
+
+        m_nNetInstances.SetDescription("Number of copies of the net forwarding different frames in parallel, each in its own thread. "
+                                       "Every copy loads its own weights. With more than one the pipeline is used as well.");
+        RegisterPropertyVariable("net_instances", m_nNetInstances);
+        m_nDispatch.SetDescription("Round robin hands the frames to the instances in turn, least loaded to the instance with the fewest frames in flight.");
+        m_nDispatch.SetValueList({
+            {DP_RoundRobin, "round_robin"},
+            {DP_LeastLoaded, "least_loaded"},
+            });
+        RegisterPropertyVariable("net_dispatch", m_nDispatch);
+        m_nThreadsPerInstance.SetDescription("Number of threads OpenCV uses within one forward call, 0 keeps the default. "
+                                             "The setting is process wide and affects all OpenCV filters.");
+        RegisterPropertyVariable("threads_per_instance", m_nThreadsPerInstance);
+        m_bSharedModelCache.SetDescription("Get the nets from the DNN Model Cache Service if it is running, so filters with the same model, backend, target and blob size share them. "
+                                           "Saves memory and load time, but the filters then wait for each other while forwarding.");
+        RegisterPropertyVariable("shared_model_cache", m_bSharedModelCache);
+
+        m_nPrecision.SetDescription("Numeric precision of the inference. fp16 selects the FP16 variant of the target (CPU needs OpenCV 4.9). "
+                                    "int8 loads quantized_module or quantizes the model on load with calibration_image, it runs on the OpenCV backend.");
+        m_nPrecision.SetValueList({
+            {PR_FP32, "fp32"},
+            {PR_FP16, "fp16"},
+            {PR_INT8, "int8"},
+            });
+        RegisterPropertyVariable("precision", m_nPrecision);
+        m_strQuantizedModule.SetDescription("Already quantized model (e.g. an int8 ONNX export) used instead of module with precision int8.");
+        RegisterPropertyVariable("quantized_module", m_strQuantizedModule);
+        m_strCalibrationImage.SetDescription("Representative image used to quantize the model on load with precision int8 if there is no quantized_module.");
+        RegisterPropertyVariable("calibration_image", m_strCalibrationImage);
+        m_bPrecisionCompare.SetDescription("Forward every n-th frame through an additional fp32 copy of the net as well and publish the time, "
+                                           "the largest output difference and the fraction of matching detections of both.");
+        RegisterPropertyVariable("precision_compare", m_bPrecisionCompare);
+        m_nPrecisionCompareInterval.SetDescription("Compare every n-th forward call with precision_compare.");
+        RegisterPropertyVariable("precision_compare_interval", m_nPrecisionCompareInterval);
+        set_property<tFloat64>(*this, "precision_reduced_time", 0.0);
+        set_property<tFloat64>(*this, "precision_reference_time", 0.0);
+        set_property<tFloat64>(*this, "precision_max_error", 0.0);
+        set_property<tFloat64>(*this, "precision_detection_agreement", 0.0);
+
+        m_bGovernor.SetDescription("Skip frames when the net is slower than the camera, so the latency does not grow. "
+                                   "The inference rate follows the measured forward time, the batch size and the number of net instances. "
+                                   "The frames are inferred in the trigger thread or the pipeline, the async workers are not used.");
+        RegisterPropertyVariable("rate_governor", m_bGovernor);
+        m_fMinDetectionRate.SetDescription("Frames per second and input which are inferred at least, even if they pile up. 0 for no minimum.");
+        RegisterPropertyVariable("min_detection_rate", m_fMinDetectionRate);
+        m_bSkipPassThrough.SetDescription("Send the last detections of the input with the time of every frame skipped by the rate governor or the motion gating. "
+                                          "They keep the order of the frames, a skipped frame waits for the inferred frames before it.");
+        RegisterPropertyVariable("skip_pass_through", m_bSkipPassThrough);
+        set_property<tUInt64>(*this, "governor_skipped_frames", 0);
+        set_property<tFloat64>(*this, "governor_forward_latency", 0.0);
+
+        m_bMotionGating.SetDescription("Only infer frames which differ from the background. The changed pixels are sent on the pins motion_mask and motion_mask_<n>. "
+                                       "The inference runs in the trigger thread unless the pipeline is used.");
+        RegisterPropertyVariable("motion_gating", m_bMotionGating);
+        m_bMotionRoi.SetDescription("Only infer the region around the changed pixels. The raw outputs on mat_out refer to this region, the detections to the whole frame.");
+        RegisterPropertyVariable("motion_roi", m_bMotionRoi);
+        m_nMotionWidth.SetDescription("Width in pixels the frames are downscaled to for the comparison with the background.");
+        RegisterPropertyVariable("motion_width", m_nMotionWidth);
+        m_fMotionThreshold.SetDescription("Minimum difference of a pixel to the background in grey levels.");
+        RegisterPropertyVariable("motion_threshold", m_fMotionThreshold);
+        m_fMotionMinArea.SetDescription("Fraction of the pixels which need to change to infer the frame.");
+        RegisterPropertyVariable("motion_min_area", m_fMotionMinArea);
+        m_fMotionLearningRate.SetDescription("Weight of every frame in the running average background, higher values forget stopped objects faster.");
+        RegisterPropertyVariable("motion_learning_rate", m_fMotionLearningRate);
+
+        m_bTiling.SetDescription("Split large frames into overlapping tiles which are inferred together as one batch, so small objects keep their size. "
+                                 "With motion gating only the region around the motion is tiled. The tiles bypass batch_size.");
+        RegisterPropertyVariable("tiling", m_bTiling);
+        m_nTileSize.SetDescription("Width and height of a tile in frame pixels.");
+        RegisterPropertyVariable("tile_size", m_nTileSize);
+        m_nTileOverlap.SetDescription("Minimum overlap of neighbouring tiles in frame pixels, should be larger than the objects cut at a border.");
+        RegisterPropertyVariable("tile_overlap", m_nTileOverlap);
+        m_bTileFullFrame.SetDescription("Infer the downscaled frame in addition to the tiles to find objects larger than a tile. "
+                                        "Its raw output is sent on mat_out, without it mat_out gets the output of the first tile.");
+        RegisterPropertyVariable("tile_full_frame", m_bTileFullFrame);
+        m_fTileNmsThreshold.SetDescription("Detections of different tiles overlapping by more than this intersection over union are merged.");
+        RegisterPropertyVariable("tile_nms_threshold", m_fTileNmsThreshold);
+
+        m_bBackgroundLoad.SetDescription("Load the model in a background thread, so the graph starts without waiting for it. "
+                                         "Frames arriving before the net is ready are handled by not_ready_policy.");
+        RegisterPropertyVariable("background_load", m_bBackgroundLoad);
+        m_nNotReadyPolicy.SetDescription("Handling of frames arriving while the net is still loading.");
+        m_nNotReadyPolicy.SetValueList({
+            {NR_EmptyDetections, "empty_detections"},
+            {NR_Drop, "drop"},
+            });
+        RegisterPropertyVariable("not_ready_policy", m_nNotReadyPolicy);
+        m_nWarmupIterations.SetDescription("Number of forward passes on a blank blob before the net is ready, "
+                                           "so the first frame does not pay for the lazy initialization of the backend.");
+        RegisterPropertyVariable("warmup_iterations", m_nWarmupIterations);
+        set_property<tBool>(*this, "ready", tFalse);
+        set_property<tFloat64>(*this, "load_time", 0.0);
+        set_property<tFloat64>(*this, "warmup_time", 0.0);
+
+        m_nOutputPoolSize.SetDescription("Number of preallocated output tensors which are recycled once downstream released them.");
+        RegisterPropertyVariable("output_pool_size", m_nOutputPoolSize);
+        set_property<tUInt64>(*this, "allocations", 0);
+
+        // the output is a raw tensor and not an image of the stream format
+        m_nMatPoolSize = 0;
+
+        m_nPreprocessStage = AddLatencyStage("preprocess");
+        m_nForwardStage = AddLatencyStage("forward");
+        m_nDecodeStage = AddLatencyStage("decode");
+        m_nEmitStage = AddLatencyStage("emit");
+
+        object_ptr<IStreamType> pDetectionType = make_object_ptr<cStreamType>(stream_meta_type_detections());
+        m_vecDetectionOutputs = { CreateOutputPin("detections", pDetectionType) };
     }
     
     ~cDNNOpenCVFilter()
     {
-        
+        JoinLoadThread();
     }
 
-    tResult OnStagePreConnect() override
+    tResult OnStageFirst() override
     {
-        if (!cFileSystem::Exists(m_strConfig))
+        m_vecBatchInputs = { m_pInput };
+        m_vecBatchOutputs = { m_pOutput };
+
+        for (tInt32 nInput = 1; nInput < m_nBatchInputs; ++nInput)
         {
-            RETURN_ERROR_DESC(ERR_NOT_FOUND, "Could not find dnn config at %s", m_strConfig->GetPtr());
+            object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
+            cPinWriter* pOutput = CreateOutputPin(cString::Format("mat_out_%d", nInput), pStreamType);
+            cPinReader* pInput = CreateInputPin(cString::Format("mat_in_%d", nInput), pStreamType);
+            pInput->SetAcceptTypeCallback([pOutput](const iobject_ptr<const IStreamType>& pType) -> tResult
+            {
+                return pOutput->ChangeType(pType);
+            });
+
+            m_vecBatchInputs.push_back(pInput);
+            m_vecBatchOutputs.push_back(pOutput);
+
+            object_ptr<IStreamType> pDetectionType = make_object_ptr<cStreamType>(stream_meta_type_detections());
+            m_vecDetectionOutputs.push_back(CreateOutputPin(cString::Format("detections_%d", nInput), pDetectionType));
         }
-        if (!cFileSystem::Exists(m_strModule))
+
+        m_vecSequencers.clear();
+        for (tSize nInput = 0; nInput < m_vecBatchInputs.size(); ++nInput)
         {
-            RETURN_ERROR_DESC(ERR_NOT_FOUND, "Could not find dnn module at %s", m_strModule->GetPtr());
+            m_vecSequencers.emplace_back(new cDetectionSequencer());
         }
-        
-        LOG_INFO("Load DNN Config %s", m_strConfig->GetPtr());
-        LOG_INFO("Load DNN Module %s", m_strModule->GetPtr());
 
-        try
+        if (m_bMotionGating)
         {
-            m_oDnnNet = readNet(m_strConfig->GetPtr(),
-                m_strModule->GetPtr());
+            object_ptr<IStreamType> pMaskType = make_object_ptr<cStreamType>(stream_meta_type_mat());
+            m_vecMotionOutputs = { CreateOutputPin("motion_mask", pMaskType) };
+            for (tInt32 nInput = 1; nInput < m_nBatchInputs; ++nInput)
+            {
+                m_vecMotionOutputs.push_back(CreateOutputPin(cString::Format("motion_mask_%d", nInput), pMaskType));
+            }
         }
-        catch (std::exception oException)
+
+        RETURN_NOERROR;
+    }
+
+    tResult Start() override
+    {
+        RETURN_IF_FAILED(cOpenCVBaseFilter::Start());
+
         {
-            LOG_ERROR("Failed to created DNN Net %s", oException.what());
-            RETURN_ERROR_DESC(ERR_FAILED, "Failed to created DNN Net %s", oException.what());
+            std::lock_guard<std::mutex> oLock(m_oGovernorMutex);
+            m_fForwardLatency = 0.0;
+            m_vecLastAdmitted.assign(m_vecBatchInputs.size(), std::chrono::steady_clock::time_point());
         }
-        if (m_oDnnNet.empty())
+        for (auto & pSequencer : m_vecSequencers)
         {
-            RETURN_ERROR_DESC(ERR_NOT_READY, "Error while creating Dnn net");
+            pSequencer->Reset();
         }
 
-        m_oDnnNet.setPreferableBackend(m_nBackend);
-        m_oDnnNet.setPreferableTarget(m_nTarget);
-        
-        m_vecOutputLayerNames.clear();
+        cMotionDetector oMotionDetector;
+        oMotionDetector.m_nWidth = m_nMotionWidth;
+        oMotionDetector.m_fThreshold = m_fMotionThreshold;
+        oMotionDetector.m_fMinArea = m_fMotionMinArea;
+        oMotionDetector.m_fLearningRate = m_fMotionLearningRate;
+        m_vecMotionDetectors.assign(m_vecBatchInputs.size(), oMotionDetector);
 
-        std::vector<int> unconnectedLayers = m_oDnnNet.getUnconnectedOutLayers();
-        std::vector<String> allLayerNames = m_oDnnNet.getLayerNames();
-        m_vecOutputLayerNames.resize(unconnectedLayers.size());
-        
-        for (size_t i = 0; i < unconnectedLayers.size(); ++i)
+        if (IsPipelining())
+        {
+            m_oFreeRequests.Open();
+            m_oDecodeRequests.Open();
+            for (auto & oRequest : m_vecRequests)
+            {
+                m_oFreeRequests.Push(&oRequest);
+            }
+
+            for (tSize nInstance = 0; nInstance < m_vecNets.size(); ++nInstance)
+            {
+                tNetInstance* pInstance = m_vecNets[nInstance].get();
+                pInstance->nInFlight = 0;
+                pInstance->oRequests.Open();
+                pInstance->oThread = kernel_thread_looper(cString::Format("%s::forward_%d", get_named_graph_object_full_name(*this).GetPtr(), static_cast<tInt32>(nInstance)),
+                    [this, pInstance] { ForwardRequests(*pInstance); });
+                if (!pInstance->oThread.Joinable())
+                {
+                    RETURN_ERROR_DESC(ERR_UNEXPECTED, "Unable to create forward thread of net instance %d", static_cast<tInt32>(nInstance));
+                }
+            }
+
+            m_oDecodeThread = kernel_thread_looper(cString(get_named_graph_object_full_name(*this) + "::decode"),
+                &cDNNOpenCVFilter::DecodeRequests, this);
+            if (!m_oDecodeThread.Joinable())
+            {
+                RETURN_ERROR_DESC(ERR_UNEXPECTED, "Unable to create pipeline threads");
+            }
+        }
+
+        if (IsBatching())
         {
-            m_vecOutputLayerNames.push_back(allLayerNames[unconnectedLayers[i] - 1]);
+            m_oBatchTimer = kernel_thread_looper(cString(get_named_graph_object_full_name(*this) + "::batch_timeout"),
+                &cDNNOpenCVFilter::FlushExpiredBatch, this);
+            if (!m_oBatchTimer.Joinable())
+            {
+                RETURN_ERROR_DESC(ERR_UNEXPECTED, "Unable to create batch timeout thread");
+            }
         }
 
         RETURN_NOERROR;
     }
 
-    std::vector<String> getOutputsNames(const Net& net)
+    tResult Stop() override
     {
-        static std::vector<String> names;
-        if (names.empty())
+        // the loader allocates the buffers of the requests dropped below
+        JoinLoadThread();
+
+        // wakes up a trigger thread waiting for a free request as well
+        m_oFreeRequests.Close();
+        m_oDecodeRequests.Close();
+        for (auto & pInstance : m_vecNets)
+        {
+            pInstance->oRequests.Close();
+        }
+
+        m_oBatchCondition.notify_all();
+        m_oBatchTimer = kernel_thread_looper();
+        for (auto & pInstance : m_vecNets)
+        {
+            pInstance->oThread = kernel_thread_looper();
+        }
+        m_oDecodeThread = kernel_thread_looper();
         {
-            std::vector<int> outLayers = net.getUnconnectedOutLayers();
-            std::vector<String> layersNames = net.getLayerNames();
-            names.resize(outLayers.size());
-            for (size_t i = 0; i < outLayers.size(); ++i)
-                names[i] = layersNames[outLayers[i] - 1];
+            std::lock_guard<std::mutex> oLock(m_oBatchMutex);
+            m_vecBatch.clear();
         }
-        return names;
+
+        // requests still in flight are dropped
+        for (auto & oRequest : m_vecRequests)
+        {
+            oRequest.vecEntries.clear();
+            oRequest.oAsyncOutput.release();
+            oRequest.bForwarded = tFalse;
+        }
+
+        return cOpenCVBaseFilter::Stop();
     }
 
-    cv::Mat ProcessMat(const cv::Mat & oMat)
+    tBool IsBatching() const
     {
-        if (!m_oDnnNet.empty())
+        return m_nBatchSize > 1 || m_vecBatchInputs.size() > 1;
+    }
+
+    tBool IsPipelining() const
+    {
+        return m_nPipelineDepth > 1 || m_nNetInstances > 1;
+    }
+
+    tBool IsLoaded() const
+    {
+        return m_bNetReady;
+    }
+
+    tResult ProcessInput(ISampleReader* pReader,
+        const iobject_ptr<const ISample>& pSample) override
+    {
+        auto itInput = std::find(m_vecBatchInputs.begin(), m_vecBatchInputs.end(), pReader);
+        if (itInput == m_vecBatchInputs.end())
         {
-            Mat oBlob = blobFromImage(oMat,
-                1.0/255.0,
-                Size(m_fBlobWidth, m_fBlobHeight),
-                Scalar(m_fBlobMeanRed, m_fBlobMeanGreen, m_fBlobMeanBlue),
-                true,
-                false);
+            RETURN_ERROR_DESC(ERR_NOT_FOUND, "Sample from unknown pin");
+        }
+        const tSize nInput = static_cast<tSize>(itInput - m_vecBatchInputs.begin());
 
-            m_oDnnNet.setInput(oBlob);
-            if (m_oDnnNet.getLayer(0)->outputNameToIndex("im_info") != -1)  // Faster-RCNN or R-FCN
+        if (!IsLoaded())
+        {
+            if (m_nNotReadyPolicy == NR_EmptyDetections)
             {
-                resize(oMat, oMat, Size(m_fBlobWidth, m_fBlobHeight));
-                Mat imInfo = (Mat_<float>(1, 3) << m_fBlobHeight, m_fBlobWidth, 1.6f);
-                m_oDnnNet.setInput(imInfo, "im_info");
+                return WriteDetections(m_vecDetectionOutputs[nInput], std::vector<tDetection>(), object_ptr<const ISample>(pSample), tFalse);
             }
-            getOutputsNames(m_oDnnNet);
+            RETURN_NOERROR;
+        }
 
-            std::vector<Mat> outs;
-            m_oDnnNet.forward(outs, getOutputsNames(m_oDnnNet)[0]);
+        if (!IsBatching() && !IsPipelining() && !m_bTiling && !m_bMotionGating && !m_bGovernor)
+        {
+            // every frame is inferred in order, the base filter only needs the Mat
+            return cOpenCVBaseFilter::ProcessInput(pReader, pSample);
+        }
 
-            std::vector<int> outLayers = m_oDnnNet.getUnconnectedOutLayers();
-            std::string outLayerType = m_oDnnNet.getLayer(outLayers[0])->type;
+        // skipped frames are sent through the same sequencer as the inferred ones, which may still be in the pipeline
+        const tUInt64 nSequence = m_vecSequencers[nInput]->Next();
 
-            return outs[0];
+        Rect oRoi;
+        if (m_bMotionGating)
+        {
+            tBool bMotion = tTrue;
+            tResult nResult = DetectMotion(nInput, pSample, bMotion, oRoi);
+            if (IS_FAILED(nResult))
+            {
+                m_vecSequencers[nInput]->Drop(nSequence, ResultWriter(nInput, tFalse));
+                return nResult;
+            }
+            if (!bMotion)
+            {
+                return PassThrough(nInput, nSequence, pSample);
+            }
         }
 
-        return Mat();
-    }
-    
-};
+        if (m_bGovernor && !Admit(nInput))
+        {
+            return PassThrough(nInput, nSequence, pSample);
+        }
 
-class cDNNOpenCVPlotFilter : public cOpenCVBaseFilter
-{
-public:
-    ADTF_CLASS_ID_NAME(cDNNOpenCVPlotFilter,
-        "dnn_plot.opencv.videotb.cid",
-        "DNN Plot Filter");
+        if (m_bTiling)
+        {
+            return ProcessBatch(CreateTiles(nInput, nSequence, pSample, oRoi));
+        }
 
-public:
+        if (!IsBatching())
+        {
+            // the region of interest needs the batch entry, the base filter only knows about the Mat
+            return ProcessBatch({ { 0, object_ptr<const ISample>(pSample), oRoi, 0, 0, nSequence } });
+        }
 
-    cDNNOpenCVPlotFilter()
-    {
-        SetDescription("Simple DNN Result Plot");
-        object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
-        m_pDNNPin = CreateInputPin("dnn", pStreamType);
+        std::vector<tBatchEntry> vecFullBatch;
+        {
+            std::lock_guard<std::mutex> oLock(m_oBatchMutex);
+            if (m_vecBatch.empty())
+            {
+                m_tmBatchDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_nBatchTimeout);
+            }
+
+            m_vecBatch.push_back({ nInput, object_ptr<const ISample>(pSample), oRoi, 0, 0, nSequence });
+            if (m_vecBatch.size() >= static_cast<tSize>(*m_nBatchSize))
+            {
+                vecFullBatch.swap(m_vecBatch);
+            }
+        }
+
+        if (!vecFullBatch.empty())
+        {
+            return ProcessBatch(vecFullBatch);
+        }
+
+        m_oBatchCondition.notify_one();
+        RETURN_NOERROR;
     }
 
-    ~cDNNOpenCVPlotFilter()
+    /**
+     * Compares the frame with the background of its input and sends the motion mask.
+     * @param [out] bMotion tFalse if the frame does not need to be inferred
+     * @param [out] oRoi region of the frame to infer, empty for the whole frame
+     */
+    tResult DetectMotion(tSize nInput, const iobject_ptr<const ISample>& pSample, tBool & bMotion, Rect & oRoi)
     {
+        object_ptr<const IOpenCVSample> pMatSample = pSample;
+        if (!pMatSample || pMatSample->GetMat().empty())
+        {
+            // ignored by ProcessBatch
+            RETURN_NOERROR;
+        }
+
+        const Mat & oFrame = pMatSample->GetMat();
+        Mat oMask;
+        bMotion = m_vecMotionDetectors[nInput].Detect(oFrame, oMask, oRoi);
+        oRoi = (bMotion && m_bMotionRoi) ? expand_roi(oRoi, oFrame.size()) : Rect();
+        if (oRoi == Rect(Point(0, 0), oFrame.size()))
+        {
+            oRoi = Rect();
+        }
 
+        object_ptr<ISample> pMaskSample = make_object_ptr<cOpenCVSample>(oMask);
+        pMaskSample->SetTime(pSample->GetTime());
+        return m_vecMotionOutputs[nInput]->Write(pMaskSample);
     }
 
-    tResult OnStagePreConnect() override
+    /// Creates the batch entries for the tiles of the frame, or a single entry if the area fits into one tile.
+    std::vector<tBatchEntry> CreateTiles(tSize nInput, tUInt64 nSequence, const iobject_ptr<const ISample>& pSample, const Rect & oRoi) const
     {
-        
-        RETURN_NOERROR;
+        object_ptr<const IOpenCVSample> pMatSample = pSample;
+        if (!pMatSample || pMatSample->GetMat().empty())
+        {
+            return { { nInput, object_ptr<const ISample>(pSample), oRoi, 0, 0, nSequence } };
+        }
+
+        const Rect oFrame(Point(0, 0), pMatSample->GetMat().size());
+        const Rect oArea = oRoi.empty() ? oFrame : oRoi;
+        std::vector<Rect> vecTiles = tile_rects(oArea, m_nTileSize, m_nTileOverlap);
+        if (vecTiles.size() < 2)
+        {
+            return { { nInput, object_ptr<const ISample>(pSample), oRoi, 0, 0, nSequence } };
+        }
+
+        if (m_bTileFullFrame)
+        {
+            vecTiles.insert(vecTiles.begin(), oArea);
+        }
+
+        std::vector<tBatchEntry> vecEntries;
+        for (tSize nPart = 0; nPart < vecTiles.size(); ++nPart)
+        {
+            vecEntries.push_back({ nInput, object_ptr<const ISample>(pSample), vecTiles[nPart] == oFrame ? Rect() : vecTiles[nPart], nPart, vecTiles.size(), nSequence });
+        }
+        return vecEntries;
     }
 
-    tResult ProcessInput(ISampleReader* pReader,
-        const iobject_ptr<const ISample>& pSample) override
+    /**
+     * Decides whether a frame of the input is inferred. The interval between two inferred frames of one input is the
+     * time the net instances need per frame, shortened to reach the minimum detection rate.
+     */
+    tBool Admit(tSize nInput)
     {
-        if (pReader == m_pDNNPin)
+        std::lock_guard<std::mutex> oLock(m_oGovernorMutex);
+
+        const tFloat64 fFramesInParallel = static_cast<tFloat64>(std::max<tSize>(m_vecNets.size(), 1) * GetMaxBatch());
+        tFloat64 fInterval = m_fForwardLatency * m_vecBatchInputs.size() / fFramesInParallel;
+        if (m_fMinDetectionRate > 0.0f)
         {
-            m_pDNNData = pSample;
-            RETURN_NOERROR;
+            fInterval = std::min(fInterval, 1.0 / m_fMinDetectionRate);
+        }
+
+        auto tmNow = std::chrono::steady_clock::now();
+        if (tmNow - m_vecLastAdmitted[nInput] < std::chrono::duration<tFloat64>(fInterval))
+        {
+            set_property<tUInt64>(*this, "governor_skipped_frames", ++m_nSkippedFrames);
+            return tFalse;
         }
 
-        return cOpenCVBaseFilter::ProcessInput(pReader, pSample);
+        m_vecLastAdmitted[nInput] = tmNow;
+        return tTrue;
     }
 
-    cv::Mat ProcessMat(const cv::Mat & oMat)
+    /**
+     * Sends the last detections of the input for a skipped frame, so downstream filters pairing frames and detections keep up.
+     * The frame waits in the sequencer of the input until the frames before it left the pipeline.
+     */
+    tResult PassThrough(tSize nInput, tUInt64 nSequence, const iobject_ptr<const ISample>& pSample)
     {
-        cv::Mat oResult = oMat;
+        if (m_bSkipPassThrough)
+        {
+            m_vecSequencers[nInput]->PassThrough(nSequence, object_ptr<const ISample>(pSample), ResultWriter(nInput, tFalse));
+        }
+        else
+        {
+            m_vecSequencers[nInput]->Drop(nSequence, ResultWriter(nInput, tFalse));
+        }
+        RETURN_NOERROR;
+    }
 
-        if(m_pDNNData)
+    /**
+     * Writes the detections and the raw output of a frame released by the sequencer of the input.
+     * @param [in] bManualTrigger tTrue if the caller does not run within a trigger, the frames released by the
+     *             sequencer are written by the calling thread
+     */
+    cDetectionSequencer::tEmitFunction ResultWriter(tSize nInput, tBool bManualTrigger)
+    {
+        return [this, nInput, bManualTrigger](const object_ptr<const ISample>& pFrame, const std::vector<tDetection>& vecDetections,
+            const object_ptr<const ISample>& pResult)
         {
-            auto dnnMat = m_pDNNData->GetMat();
+            if (IS_FAILED(WriteDetections(m_vecDetectionOutputs[nInput], vecDetections, pFrame, bManualTrigger)))
+            {
+                LOG_ERROR("Sending the detections failed");
+            }
 
-            int w = dnnMat.cols;
-            int h = dnnMat.rows;
+            if (pResult)
+            {
+                m_vecBatchOutputs[nInput]->Write(pResult);
+                if (bManualTrigger)
+                {
+                    m_vecBatchOutputs[nInput]->ManualTrigger();
+                }
+            }
+        };
+    }
 
-            float* data = (float*)dnnMat.data;
-            for (size_t i = 0; i < dnnMat.total(); i += w)
+    /// Releases the place of frames which are not inferred in the sequencer of their input.
+    tVoid DropEntries(const std::vector<tBatchEntry>& vecEntries, tBool bManualTrigger)
+    {
+        for (auto & oEntry : vecEntries)
+        {
+            if (oEntry.nPart == 0)
             {
+                m_vecSequencers[oEntry.nInput]->Drop(oEntry.nSequence, ResultWriter(oEntry.nInput, bManualTrigger));
+            }
+        }
+    }
 
-                float confidence = 0.0;
-                size_t classid = 0;
+    /// @return the duration of this forward call in seconds
+    tFloat64 ReportForwardLatency(const std::chrono::steady_clock::time_point & tmForwardStart)
+    {
+        const tFloat64 fLatency = std::chrono::duration<tFloat64>(std::chrono::steady_clock::now() - tmForwardStart).count();
 
-                for (size_t j = 5; j < w; j++)
-                {
-                    float c = data[i + j];
+        std::lock_guard<std::mutex> oLock(m_oGovernorMutex);
+        // exponential moving average, a single slow frame must not stall the inference for long
+        m_fForwardLatency = (m_fForwardLatency == 0.0) ? fLatency : m_fForwardLatency + (fLatency - m_fForwardLatency) / 8.0;
+        if (m_bGovernor)
+        {
+            set_property<tFloat64>(*this, "governor_forward_latency", m_fForwardLatency * 1000.0);
+        }
+        return fLatency;
+    }
 
-                    if (confidence < c)
-                    {
-                        //log.info("Confidence: " + c + " " + j + " " + root.classes[j]);
-                        confidence = c;
-                        classid = j - 5;
-                    }
-                }
+    tVoid FlushExpiredBatch()
+    {
+        std::vector<tBatchEntry> vecExpiredBatch;
+        {
+            std::unique_lock<std::mutex> oLock(m_oBatchMutex);
+            if (m_vecBatch.empty())
+            {
+                m_oBatchCondition.wait_for(oLock, std::chrono::milliseconds(100));
+            }
+            else
+            {
+                m_oBatchCondition.wait_until(oLock, m_tmBatchDeadline);
+            }
 
-                if (confidence > 0.05)
-                {
-                    int center_x = (int) (data[i + 0] * oMat.cols);
-                    int center_y = (int) (data[i + 1] * oMat.rows);
-                    int width = (int) (data[i + 2] * oMat.cols);
-                    int height = (int) (data[i + 3] * oMat.rows);
-                    
-                    DrawPred(classid, confidence, 
-                        center_x - width/2, 
-                        center_y - height/2, 
-                        center_x + width/2,
-                        center_y + height/2,
-                        oResult);
-                }
+            if (!m_vecBatch.empty() && std::chrono::steady_clock::now() >= m_tmBatchDeadline)
+            {
+                vecExpiredBatch.swap(m_vecBatch);
             }
         }
-        return oResult;
+
+        if (!vecExpiredBatch.empty() && IS_FAILED(ProcessBatch(vecExpiredBatch)))
+        {
+            LOG_ERROR("Processing of the batch after timeout failed");
+        }
     }
 
-    void DrawPred(int classId, float conf, int left, int top, int right, int bottom, Mat& frame)
+    tResult ProcessBatch(const std::vector<tBatchEntry>& vecBatch)
     {
-        rectangle(frame, Point(left, top), Point(right, bottom), Scalar(0, 255, 0), 2);
+        std::vector<tBatchEntry> vecEntries;
+        std::vector<tBatchEntry> vecIgnored;
+        for (auto & oEntry : vecBatch)
+        {
+            object_ptr<const IOpenCVSample> pMatSample = oEntry.pSample;
+            if (pMatSample && !pMatSample->GetMat().empty())
+            {
+                vecEntries.push_back(oEntry);
+            }
+            else
+            {
+                vecIgnored.push_back(oEntry);
+            }
+        }
 
-        std::string label = format("%.2f", conf);
-        if (!lstClasses.empty())
+        // the batch may be flushed by the timeout thread, which does not run within a trigger
+        DropEntries(vecIgnored, tTrue);
+        if (vecEntries.empty() || !IsLoaded())
         {
-            CV_Assert(classId < (int)lstClasses.size());
-            label = lstClasses[classId] + ": " + label;
+            DropEntries(vecEntries, tTrue);
+            RETURN_NOERROR;
         }
 
-        int baseLine;
-        Size labelSize = getTextSize(label, FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+        if (IsPipelining())
+        {
+            return Submit(std::move(vecEntries));
+        }
 
-        top = max(top, labelSize.height);
-        rectangle(frame, Point(left, top - labelSize.height),
-            Point(left + labelSize.width, top + baseLine), Scalar::all(255), FILLED);
-        putText(frame, label, Point(left, top), FONT_HERSHEY_SIMPLEX, 0.5, Scalar());
+        std::vector<Mat> vecResults;
+        std::vector<std::vector<tDetection>> vecDetections;
+        {
+            // the batch may be flushed by a trigger thread or the timeout thread
+            tNetInstance & oInstance = *m_vecNets[0];
+            std::lock_guard<std::mutex> oLock(oInstance.pNet->oMutex);
+            tRequest & oRequest = m_vecRequests[0];
+            oRequest.vecEntries = vecEntries;
+            Infer(oInstance, oRequest);
+            oRequest.vecEntries.clear();
+            vecResults.swap(oRequest.vecResults);
+            vecDetections.swap(oRequest.vecDetections);
+        }
+
+        // the batch contains frames of other pins and may be flushed by the timeout thread. Another thread may emit
+        // a batch inferred before this one meanwhile, the sequencers keep detections and mat_out in order.
+        return Emit(vecEntries, vecResults, vecDetections, tTrue);
     }
 
+    /**
+     * Hands the frames over to the pipeline. The frames are preprocessed in the calling thread,
+     * which blocks while all requests are in flight.
+     */
+    tResult Submit(std::vector<tBatchEntry>&& vecEntries)
+    {
+        tRequest* pRequest = nullptr;
+        while (!m_oFreeRequests.Pop(pRequest, std::chrono::milliseconds(100)))
+        {
+            if (m_oFreeRequests.IsClosed())
+            {
+                // the sequencers are reset on the next start
+                RETURN_NOERROR;
+            }
+        }
 
-private:
-    cPinReader* m_pDNNPin;
-    object_ptr<const IOpenCVSample> m_pDNNData;
+        pRequest->vecEntries = std::move(vecEntries);
+        pRequest->bForwarded = tFalse;
+        Prepare(*pRequest);
+
+        tNetInstance & oInstance = SelectInstance();
+        ++oInstance.nInFlight;
+        // the decode stage gets the requests in submission order, whichever instance finishes first
+        m_oDecodeRequests.Push(pRequest);
+        oInstance.oRequests.Push(pRequest);
+
+        RETURN_NOERROR;
+    }
+
+    tNetInstance & SelectInstance()
+    {
+        if (m_nDispatch == DP_LeastLoaded)
+        {
+            return **std::min_element(m_vecNets.begin(), m_vecNets.end(),
+                [](const std::unique_ptr<tNetInstance>& pFirst, const std::unique_ptr<tNetInstance>& pSecond)
+            {
+                return pFirst->nInFlight < pSecond->nInFlight;
+            });
+        }
+        return *m_vecNets[m_nNextInstance++ % m_vecNets.size()];
+    }
+
+    tVoid ForwardRequests(tNetInstance & oInstance)
+    {
+        tRequest* pRequest = nullptr;
+        if (oInstance.oRequests.Pop(pRequest, std::chrono::milliseconds(100)))
+        {
+            {
+                std::lock_guard<std::mutex> oLock(oInstance.pNet->oMutex);
+                Forward(oInstance, *pRequest, tTrue);
+            }
+            --oInstance.nInFlight;
+            {
+                std::lock_guard<std::mutex> oLock(m_oForwardedMutex);
+                pRequest->bForwarded = tTrue;
+            }
+            m_oForwardedCondition.notify_all();
+        }
+    }
+
+    /// Waits until the request left its net instance, tFalse if the pipeline was stopped before.
+    tBool WaitForwarded(tRequest & oRequest)
+    {
+        std::unique_lock<std::mutex> oLock(m_oForwardedMutex);
+        while (!m_oForwardedCondition.wait_for(oLock, std::chrono::milliseconds(100), [&oRequest] { return oRequest.bForwarded; }))
+        {
+            if (m_oDecodeRequests.IsClosed())
+            {
+                return tFalse;
+            }
+        }
+        return tTrue;
+    }
+
+    tVoid DecodeRequests()
+    {
+        tRequest* pRequest = nullptr;
+        if (m_oDecodeRequests.Pop(pRequest, std::chrono::milliseconds(100)))
+        {
+            if (!WaitForwarded(*pRequest))
+            {
+                return;
+            }
+
+            Decode(*pRequest);
+            // we are not running within a trigger, so the samples need to be pushed downstream
+            if (IS_FAILED(Emit(pRequest->vecEntries, pRequest->vecResults, pRequest->vecDetections, tTrue)))
+            {
+                LOG_ERROR("Sending the results of the pipeline failed");
+            }
+            pRequest->vecEntries.clear();
+            m_oFreeRequests.Push(pRequest);
+        }
+    }
+
+    /// Runs all stages of a request in the calling thread, the mutex of the instance has to be locked.
+    tVoid Infer(tNetInstance & oInstance, tRequest & oRequest)
+    {
+        Prepare(oRequest);
+        Forward(oInstance, oRequest, tFalse);
+        Decode(oRequest);
+    }
+
+    /// Fills the blob of the request, only touches the request itself. The images of a batch (e.g. tiles) are filled in parallel.
+    tVoid Prepare(tRequest & oRequest)
+    {
+        cLatencyTimer oTimer(GetLatencyStage(m_nPreprocessStage));
+        const int nBatch = static_cast<int>(oRequest.vecEntries.size());
+        if (nBatch > GetBlobBatch(oRequest))
+        {
+            // more tiles than batch_size, the blob keeps the new size so the net is reshaped only once
+            CreateBlob(oRequest, nBatch);
+        }
+        PadBlob(oRequest, nBatch);
+        parallel_for_(Range(0, nBatch), [this, &oRequest](const Range & oRange)
+        {
+            for (int nImage = oRange.start; nImage < oRange.end; ++nImage)
+            {
+                const tBatchEntry & oEntry = oRequest.vecEntries[nImage];
+                object_ptr<const IOpenCVSample> pMatSample = oEntry.pSample;
+                const Mat & oFrame = pMatSample->GetMat();
+                FillBlob(oRequest, oEntry.oRoi.empty() ? oFrame : oFrame(oEntry.oRoi), nImage);
+            }
+        });
+    }
+
+    /**
+     * Forwards the blob through all unconnected output layers of the net in one call, the mutex of the instance has to be locked.
+     * @param [in] bOwnOutputs copy the outputs into the request, they are decoded while the net runs the next request
+     */
+    tVoid Forward(tNetInstance & oInstance, tRequest & oRequest, tBool bOwnOutputs)
+    {
+        // only the submission of asynchronous forwards, Decode waits for the result
+        cLatencyTimer oTimer(GetLatencyStage(m_nForwardStage));
+        Net & oNet = oInstance.pNet->oNet;
+        try
+        {
+            oRequest.tmForwardStart = std::chrono::steady_clock::now();
+            oNet.setInput(oRequest.oBlob);
+            if (m_bImInfo)
+            {
+                oNet.setInput(m_oImInfo, "im_info");
+            }
+
+            if (m_bForwardAsync)
+            {
+                // the backend runs the request while the next one is prepared, Decode waits for the result
+                oRequest.oAsyncOutput = oNet.forwardAsync(m_vecOutputLayerNames[0]);
+            }
+            else if (bOwnOutputs)
+            {
+                oNet.forward(oInstance.vecOuts, m_vecOutputLayerNames);
+                oRequest.vecOuts.resize(oInstance.vecOuts.size());
+                for (tSize nOut = 0; nOut < oInstance.vecOuts.size(); ++nOut)
+                {
+                    oInstance.vecOuts[nOut].copyTo(oRequest.vecOuts[nOut]);
+                }
+                ComparePrecision(oRequest, ReportForwardLatency(oRequest.tmForwardStart));
+            }
+            else
+            {
+                oNet.forward(oRequest.vecOuts, m_vecOutputLayerNames);
+                ComparePrecision(oRequest, ReportForwardLatency(oRequest.tmForwardStart));
+            }
+        }
+        catch (cv::Exception & oException)
+        {
+            LOG_ERROR("Forward failed: %s", oException.what());
+            oRequest.vecOuts.clear();
+        }
+    }
+
+    /**
+     * Forwards the blob of the request through the fp32 reference net and compares the outputs and the
+     * detections of the first image. Asynchronous forwards are not compared, their outputs are not available yet.
+     * @param [in] fReducedTime duration of the forward call with reduced precision in seconds
+     */
+    tVoid ComparePrecision(const tRequest & oRequest, tFloat64 fReducedTime)
+    {
+        if (!m_pReferenceNet || m_nCompareCounter++ % std::max<tInt32>(m_nPrecisionCompareInterval, 1) != 0)
+        {
+            return;
+        }
+
+        std::vector<Mat> vecReferenceOuts;
+        std::vector<tDetection> vecReduced;
+        std::vector<tDetection> vecReference;
+        tFloat64 fMaxError = 0.0;
+        tFloat64 fReferenceTime = 0.0;
+        {
+            std::lock_guard<std::mutex> oLock(m_pReferenceNet->oMutex);
+            Net & oNet = m_pReferenceNet->oNet;
+            auto tmStart = std::chrono::steady_clock::now();
+            try
+            {
+                oNet.setInput(oRequest.oBlob);
+                if (m_bImInfo)
+                {
+                    oNet.setInput(m_oImInfo, "im_info");
+                }
+                oNet.forward(vecReferenceOuts, m_vecOutputLayerNames);
+            }
+            catch (cv::Exception & oException)
+            {
+                LOG_WARNING("Reference forward failed: %s", oException.what());
+                return;
+            }
+            fReferenceTime = std::chrono::duration<tFloat64>(std::chrono::steady_clock::now() - tmStart).count();
+
+            const tSize nBatch = GetBlobBatch(oRequest);
+            const tSize nOuts = std::min({ oRequest.vecOuts.size(), vecReferenceOuts.size(), m_vecOutputLayerTypes.size() });
+            for (tSize nOut = 0; nOut < nOuts && nBatch > 0; ++nOut)
+            {
+                if (oRequest.vecOuts[nOut].size == vecReferenceOuts[nOut].size)
+                {
+                    fMaxError = std::max(fMaxError, norm(oRequest.vecOuts[nOut], vecReferenceOuts[nOut], NORM_INF));
+                }
+                DecodeDetections(SplitBatchOutput(oRequest.vecOuts[nOut], nBatch, 0), m_vecOutputLayerTypes[nOut], oRequest.vecGeometry[0], vecReduced);
+                DecodeDetections(SplitBatchOutput(vecReferenceOuts[nOut], nBatch, 0), m_vecOutputLayerTypes[nOut], oRequest.vecGeometry[0], vecReference);
+            }
+        }
+
+        // a reference detection is found if the reduced net reports the same class at almost the same place
+        tSize nMatched = 0;
+        for (auto & sReference : vecReference)
+        {
+            for (auto & sReduced : vecReduced)
+            {
+                if (sReduced.nClassId == sReference.nClassId && intersection_over_union(sReduced, sReference) > 0.5f)
+                {
+                    ++nMatched;
+                    break;
+                }
+            }
+        }
+
+        set_property<tFloat64>(*this, "precision_reduced_time", fReducedTime * 1000.0);
+        set_property<tFloat64>(*this, "precision_reference_time", fReferenceTime * 1000.0);
+        set_property<tFloat64>(*this, "precision_max_error", fMaxError);
+        set_property<tFloat64>(*this, "precision_detection_agreement",
+            vecReference.empty() ? 1.0 : static_cast<tFloat64>(nMatched) / vecReference.size());
+    }
+
+    /// Splits the outputs per image, decodes the detections and copies the raw outputs into recycled buffers.
+    tVoid Decode(tRequest & oRequest)
+    {
+        cLatencyTimer oTimer(GetLatencyStage(m_nDecodeStage));
+        if (oRequest.oAsyncOutput.valid())
+        {
+            try
+            {
+                oRequest.vecOuts.resize(1);
+                oRequest.oAsyncOutput.get(oRequest.vecOuts[0]);
+                ReportForwardLatency(oRequest.tmForwardStart);
+            }
+            catch (cv::Exception & oException)
+            {
+                LOG_ERROR("Asynchronous forward failed: %s", oException.what());
+                oRequest.vecOuts.clear();
+            }
+            oRequest.oAsyncOutput.release();
+        }
+
+        const tSize nBatch = oRequest.vecEntries.size();
+        // the outputs contain the padded images of the blob as well
+        const tSize nBlobBatch = GetBlobBatch(oRequest);
+        const tSize nOuts = std::min(oRequest.vecOuts.size(), m_vecOutputLayerTypes.size());
+        oRequest.vecResults.assign(nBatch, Mat());
+        oRequest.vecDetections.resize(nBatch);
+
+        std::vector<Mat> vecImageOuts(nOuts);
+        for (tSize nImage = 0; nImage < nBatch; ++nImage)
+        {
+            oRequest.vecDetections[nImage].clear();
+            if (nOuts == 0)
+            {
+                continue;
+            }
+
+            for (tSize nOut = 0; nOut < nOuts; ++nOut)
+            {
+                vecImageOuts[nOut] = SplitBatchOutput(oRequest.vecOuts[nOut], nBlobBatch, nImage);
+                DecodeDetections(vecImageOuts[nOut], m_vecOutputLayerTypes[nOut], oRequest.vecGeometry[nImage], oRequest.vecDetections[nImage]);
+            }
+
+            const tBatchEntry & oEntry = oRequest.vecEntries[nImage];
+            if (!oEntry.oRoi.empty())
+            {
+                object_ptr<const IOpenCVSample> pMatSample = oEntry.pSample;
+                for (auto & sDetection : oRequest.vecDetections[nImage])
+                {
+                    roi_to_frame(sDetection, oEntry.oRoi, pMatSample->GetMat().size());
+                }
+            }
+
+            // only the first part of a tiled frame is sent on mat_out
+            if (oEntry.nPart == 0)
+            {
+                oRequest.vecResults[nImage] = CopyToPool(vecImageOuts);
+            }
+        }
+
+        MergeTiles(oRequest);
+    }
+
+    /// Moves the detections of all tiles of a frame into its first entry and removes the duplicates found at the tile borders.
+    tVoid MergeTiles(tRequest & oRequest)
+    {
+        const tSize nBatch = oRequest.vecEntries.size();
+        for (tSize nImage = 0; nImage < nBatch; ++nImage)
+        {
+            const tBatchEntry & oEntry = oRequest.vecEntries[nImage];
+            if (oEntry.nParts < 2 || oEntry.nPart != 0)
+            {
+                continue;
+            }
+
+            std::vector<tDetection>& vecMerged = oRequest.vecDetections[nImage];
+            for (tSize nPart = 1; nPart < oEntry.nParts && nImage + nPart < nBatch; ++nPart)
+            {
+                std::vector<tDetection>& vecPart = oRequest.vecDetections[nImage + nPart];
+                vecMerged.insert(vecMerged.end(), vecPart.begin(), vecPart.end());
+                vecPart.clear();
+            }
+            suppress_detections(vecMerged, m_fTileNmsThreshold, NMS_Greedy, tTrue, 0);
+        }
+    }
+
+    tResult Emit(const std::vector<tBatchEntry>& vecEntries, const std::vector<Mat>& vecResults,
+        const std::vector<std::vector<tDetection>>& vecDetections, tBool bManualTrigger)
+    {
+        cLatencyTimer oTimer(GetLatencyStage(m_nEmitStage));
+        for (tSize nImage = 0; nImage < vecEntries.size(); ++nImage)
+        {
+            const tBatchEntry & oEntry = vecEntries[nImage];
+            if (oEntry.nPart != 0)
+            {
+                // merged into the first part of the frame
+                continue;
+            }
+
+            object_ptr<ISample> pOutSample;
+            const Mat & oResult = vecResults[nImage];
+            if (!oResult.empty())
+            {
+                pOutSample = make_object_ptr<cOpenCVSample>(oResult);
+                pOutSample->SetTime(oEntry.pSample->GetTime());
+            }
+
+            // several threads submit and decode concurrently, mat_out is written in order by the sequencer as well.
+            // Also releases the skipped frames of the input which waited for this one.
+            m_vecSequencers[oEntry.nInput]->Complete(oEntry.nSequence, oEntry.pSample, vecDetections[nImage],
+                object_ptr<const ISample>(pOutSample), ResultWriter(oEntry.nInput, bManualTrigger));
+        }
+        RETURN_NOERROR;
+    }
+
+    /**
+     * Decodes the output of one layer for one image and appends the detections above the threshold.
+     * Supports YOLO (Region) and SSD/Faster-RCNN (DetectionOutput) outputs, other layers are ignored.
+     */
+    tVoid DecodeDetections(const Mat & oOutput, const String & strLayerType, const tBlobGeometry & sGeometry, std::vector<tDetection>& vecDetections) const
+    {
+        if (oOutput.empty())
+        {
+            return;
+        }
+
+        const tFloat32 fThreshold = m_fDetectionThreshold;
+        const Size oBlobSize(m_fBlobWidth, m_fBlobHeight);
+        const int nCols = oOutput.size[oOutput.dims - 1];
+        Mat oRows(static_cast<int>(oOutput.total() / nCols), nCols, CV_32F, const_cast<uchar*>(oOutput.ptr()));
+
+        if (strLayerType == "Region" && nCols > 5)
+        {
+            // the class scores are already multiplied by the objectness, so it is a valid early reject
+            const size_t nFirst = vecDetections.size();
+            decode_region_rows(oRows, fThreshold, fThreshold, vecDetections);
+            for (size_t nDetection = nFirst; nDetection < vecDetections.size(); ++nDetection)
+            {
+                tDetection & sDetection = vecDetections[nDetection];
+                Rect2f oBox = blob_to_image(Rect2f(sDetection.fLeft, sDetection.fTop, sDetection.fWidth, sDetection.fHeight), oBlobSize, sGeometry);
+                sDetection.fLeft = oBox.x;
+                sDetection.fTop = oBox.y;
+                sDetection.fWidth = oBox.width;
+                sDetection.fHeight = oBox.height;
+            }
+        }
+        else if (strLayerType == "DetectionOutput" && nCols == 7)
+        {
+            // image id, class id, score, left, top, right, bottom
+            for (int nRow = 0; nRow < oRows.rows; ++nRow)
+            {
+                const float* pRow = oRows.ptr<float>(nRow);
+                if (pRow[2] < fThreshold)
+                {
+                    continue;
+                }
+
+                Rect2f oBox(pRow[3], pRow[4], pRow[5] - pRow[3], pRow[6] - pRow[4]);
+                if (pRow[5] > 2.0f || pRow[6] > 2.0f)
+                {
+                    // e.g. Faster-RCNN reports blob pixels instead of normalized coordinates
+                    oBox = Rect2f(oBox.x / oBlobSize.width, oBox.y / oBlobSize.height, oBox.width / oBlobSize.width, oBox.height / oBlobSize.height);
+                }
+
+                oBox = blob_to_image(oBox, oBlobSize, sGeometry);
+                vecDetections.push_back({ oBox.x, oBox.y, oBox.width, oBox.height, static_cast<tInt32>(pRow[1]), pRow[2] });
+            }
+        }
+    }
+
+    tResult WriteDetections(cPinWriter* pWriter, const std::vector<tDetection>& vecDetections,
+        const object_ptr<const ISample>& pInputSample, tBool bManualTrigger)
+    {
+        object_ptr<ISample> pSample;
+        RETURN_IF_FAILED(create_detection_sample(pSample, vecDetections));
+        pSample->SetTime(pInputSample->GetTime());
+        RETURN_IF_FAILED(pWriter->Write(pSample));
+        if (bManualTrigger)
+        {
+            pWriter->ManualTrigger();
+        }
+        RETURN_NOERROR;
+    }
+
+    /**
+     * Extracts the result of image nImage from the output of a batch with nBatch images.
+     * Handles outputs with the batch as first dimension (e.g. YOLO region layers: N x rows x cols),
+     * DetectionOutput layers (1 x 1 x detections x 7, image id in the first column) and
+     * outputs which simply stack the rows of all images.
+     */
+    static Mat SplitBatchOutput(const Mat & oOutput, tSize nBatch, tSize nImage)
+    {
+        if (nBatch == 1)
+        {
+            return oOutput;
+        }
+
+        if (oOutput.dims == 4 && oOutput.size[3] == 7)
+        {
+            Mat oDetections(static_cast<int>(oOutput.total() / 7), 7, CV_32F, const_cast<uchar*>(oOutput.ptr()));
+            Mat oResult;
+            for (int nRow = 0; nRow < oDetections.rows; ++nRow)
+            {
+                if (static_cast<tSize>(oDetections.at<float>(nRow, 0)) == nImage)
+                {
+                    oResult.push_back(oDetections.row(nRow));
+                }
+            }
+            return oResult;
+        }
+
+        if (oOutput.dims > 2 && static_cast<tSize>(oOutput.size[0]) == nBatch)
+        {
+            return Mat(oOutput.dims - 1, oOutput.size.p + 1, oOutput.type(), const_cast<uchar*>(oOutput.ptr(static_cast<int>(nImage))));
+        }
+
+        if (oOutput.dims == 2 && oOutput.rows % nBatch == 0)
+        {
+            int nRows = oOutput.rows / static_cast<int>(nBatch);
+            return oOutput.rowRange(static_cast<int>(nImage) * nRows, static_cast<int>(nImage + 1) * nRows);
+        }
+
+        LOG_ERROR("Unable to split the net output of a batch with %d images", static_cast<tInt32>(nBatch));
+        return Mat();
+    }
+
+    tResult OnStagePreConnect() override
+    {
+        if (!cFileSystem::Exists(m_strConfig))
+        {
+            RETURN_ERROR_DESC(ERR_NOT_FOUND, "Could not find dnn config at %s", m_strConfig->GetPtr());
+        }
+        if (!cFileSystem::Exists(m_strModule))
+        {
+            RETURN_ERROR_DESC(ERR_NOT_FOUND, "Could not find dnn module at %s", m_strModule->GetPtr());
+        }
+        
+        LOG_INFO("Load DNN Config %s", m_strConfig->GetPtr());
+        LOG_INFO("Load DNN Module %s", m_strModule->GetPtr());
+
+        if (m_nThreadsPerInstance > 0)
+        {
+            setNumThreads(m_nThreadsPerInstance);
+        }
+
+        // a previous load still works on the instances cleared below, assigning a joinable thread would terminate
+        JoinLoadThread();
+
+        // the instances and requests exist right away, so the pipeline threads can be started before the nets are loaded
+        m_bNetReady = tFalse;
+        m_vecNets.clear();
+        for (tInt32 nInstance = 0; nInstance < std::max<tInt32>(m_nNetInstances, 1); ++nInstance)
+        {
+            m_vecNets.emplace_back(new tNetInstance());
+        }
+
+        // every instance needs at least one request to work on
+        m_vecRequests.resize(std::max<tSize>(std::max<tInt32>(m_nPipelineDepth, 1), m_vecNets.size()));
+        for (auto & oRequest : m_vecRequests)
+        {
+            CreateBlob(oRequest, GetMaxBatch());
+        }
+
+        if (m_bBackgroundLoad)
+        {
+            m_oLoadThread = kernel_thread(cString(get_named_graph_object_full_name(*this) + "::load"), [this]
+            {
+                if (IS_FAILED(LoadNets()))
+                {
+                    LOG_ERROR("Loading the DNN in the background failed, no frames will be inferred");
+                }
+            });
+            RETURN_NOERROR;
+        }
+
+        return LoadNets();
+    }
+
+    /// Waits for a background load to finish, readNet can not be interrupted.
+    tVoid JoinLoadThread()
+    {
+        if (m_oLoadThread.joinable())
+        {
+            m_oLoadThread.join();
+        }
+    }
+
+    /// Reads the nets, determines the output layers and runs the warm-up passes. Sets the filter ready afterwards.
+    tResult LoadNets()
+    {
+        auto tmLoadStart = std::chrono::steady_clock::now();
+
+        tDNNModelKey sKey;
+        RETURN_IF_FAILED(GetModelKey(sKey));
+
+        object_ptr<IDNNModelCache> pModelCache;
+        m_bSharedNets = m_bSharedModelCache && IS_OK(_runtime->GetObject(pModelCache));
+        if (m_bSharedNets)
+        {
+            std::vector<std::shared_ptr<tSharedNet>> vecSharedNets;
+            RETURN_IF_FAILED(pModelCache->GetNets(sKey, m_vecNets.size(), vecSharedNets));
+            for (tSize nInstance = 0; nInstance < m_vecNets.size(); ++nInstance)
+            {
+                m_vecNets[nInstance]->pNet = vecSharedNets[nInstance];
+            }
+        }
+        else
+        {
+            // OpenCV has no way to share the weights between nets, every instance reads its own copy
+            for (auto & pInstance : m_vecNets)
+            {
+                tSharedNet & oShared = *pInstance->pNet;
+                std::lock_guard<std::mutex> oLock(oShared.oMutex);
+                RETURN_IF_FAILED(load_net(sKey, oShared.oNet));
+            }
+        }
+
+        m_pReferenceNet.reset();
+        if (m_bPrecisionCompare && m_nPrecision != PR_FP32)
+        {
+            tDNNModelKey sReferenceKey = { m_strConfig->GetPtr(), m_strModule->GetPtr(), m_nBackend, m_nTarget, PR_FP32, "", Mat(),
+                                           sKey.nBlobWidth, sKey.nBlobHeight, sKey.nBatch };
+            std::shared_ptr<tSharedNet> pReferenceNet = std::make_shared<tSharedNet>();
+            RETURN_IF_FAILED(load_net(sReferenceKey, pReferenceNet->oNet));
+            m_pReferenceNet = pReferenceNet;
+        }
+
+        Net & oDnnNet = m_vecNets[0]->pNet->oNet;
+        // another filter may already forward through a shared net
+        std::unique_lock<std::mutex> oNetLock(m_vecNets[0]->pNet->oMutex);
+
+        // all heads of the net (e.g. the three YOLO scales) are forwarded together
+        m_vecOutputLayerNames = oDnnNet.getUnconnectedOutLayersNames();
+        m_vecOutputLayerTypes.clear();
+        for (auto & strLayerName : m_vecOutputLayerNames)
+        {
+            m_vecOutputLayerTypes.push_back(oDnnNet.getLayer(strLayerName)->type);
+            if (m_vecOutputLayerTypes.back() != "Region" && m_vecOutputLayerTypes.back() != "DetectionOutput")
+            {
+                LOG_WARNING("No detections are decoded from output layer %s of type %s", strLayerName.c_str(), m_vecOutputLayerTypes.back().c_str());
+            }
+        }
+        // Faster-RCNN or R-FCN
+        m_bImInfo = oDnnNet.getLayer(0)->outputNameToIndex("im_info") != -1;
+        // only depends on the blob size, read by all forward threads once the nets are ready
+        m_oImInfo = (Mat_<float>(1, 3) << m_fBlobHeight, m_fBlobWidth, 1.6f);
+
+        // the result of an asynchronous forward would be pending while another filter uses the shared net
+        m_bForwardAsync = IsPipelining() && m_nBackend == DNN_BACKEND_INFERENCE_ENGINE && m_vecOutputLayerNames.size() == 1 && !m_bSharedNets;
+        if (IsPipelining() && m_nBackend == DNN_BACKEND_INFERENCE_ENGINE && !m_bForwardAsync)
+        {
+            LOG_WARNING("forwardAsync only supports nets with one output layer, the forward stage runs synchronously");
+        }
+
+        AllocateBuffers();
+        oNetLock.unlock();
+
+        const tFloat64 fLoadTime = std::chrono::duration<tFloat64, std::milli>(std::chrono::steady_clock::now() - tmLoadStart).count();
+        set_property<tFloat64>(*this, "load_time", fLoadTime);
+        LOG_INFO("Loaded %d DNN instances in %.0f ms", static_cast<tInt32>(m_vecNets.size()), fLoadTime);
+
+        auto tmWarmupStart = std::chrono::steady_clock::now();
+        Warmup();
+        const tFloat64 fWarmupTime = std::chrono::duration<tFloat64, std::milli>(std::chrono::steady_clock::now() - tmWarmupStart).count();
+        set_property<tFloat64>(*this, "warmup_time", fWarmupTime);
+        LOG_INFO("Warmed up the DNN in %.0f ms", fWarmupTime);
+
+        m_bNetReady = tTrue;
+        set_property<tBool>(*this, "ready", tTrue);
+
+        RETURN_NOERROR;
+    }
+
+    /**
+     * Describes the net to load for the configured precision. int8 uses the quantized model if there is one,
+     * otherwise the calibration image is turned into a blob for the quantization on load.
+     */
+    tResult GetModelKey(tDNNModelKey & sKey) const
+    {
+        sKey.strModule = m_strModule->GetPtr();
+        sKey.strConfig = m_strConfig->GetPtr();
+        sKey.nBackend = m_nBackend;
+        sKey.nTarget = m_nTarget;
+        sKey.nPrecision = m_nPrecision;
+        sKey.nBlobWidth = m_fBlobWidth;
+        sKey.nBlobHeight = m_fBlobHeight;
+        sKey.nBatch = GetMaxBatch();
+
+        if (m_nPrecision == PR_FP16)
+        {
+            switch (static_cast<tInt32>(m_nTarget))
+            {
+            case DNN_TARGET_OPENCL:
+                sKey.nTarget = DNN_TARGET_OPENCL_FP16;
+                break;
+            case DNN_TARGET_CUDA:
+                sKey.nTarget = DNN_TARGET_CUDA_FP16;
+                break;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+            case DNN_TARGET_CPU:
+                sKey.nTarget = DNN_TARGET_CPU_FP16;
+                break;
+#endif
+            default:
+                LOG_WARNING("The target has no fp16 variant, the inference runs with the precision of the target");
+                break;
+            }
+        }
+        else if (m_nPrecision == PR_INT8)
+        {
+            if (m_nBackend != DNN_BACKEND_OPENCV && m_nBackend != DNN_BACKEND_DEFAULT)
+            {
+                LOG_WARNING("Quantized nets only run on the OpenCV backend");
+            }
+
+            if (!m_strQuantizedModule->IsEmpty())
+            {
+                // quantized exports (e.g. ONNX) contain the whole net
+                sKey.strModule = m_strQuantizedModule->GetPtr();
+                sKey.strConfig = "";
+            }
+            else if (!m_strCalibrationImage->IsEmpty())
+            {
+                Mat oImage = imread(m_strCalibrationImage->GetPtr());
+                if (oImage.empty())
+                {
+                    RETURN_ERROR_DESC(ERR_NOT_FOUND, "Could not read the calibration image %s", m_strCalibrationImage->GetPtr());
+                }
+
+                int vecBlobShape[] = { 1, 3, m_fBlobHeight, m_fBlobWidth };
+                sKey.oCalibrationBlob.create(4, vecBlobShape, CV_32F);
+                fill_blob(oImage, sKey.oCalibrationBlob, 0, GetBlobParameters());
+                sKey.strCalibration = cString::Format("%s|%dx%d", m_strCalibrationImage->GetPtr(), static_cast<tInt32>(m_fBlobWidth), static_cast<tInt32>(m_fBlobHeight)).GetPtr();
+            }
+            else
+            {
+                RETURN_ERROR_DESC(ERR_INVALID_ARG, "Precision int8 needs a quantized_module or a calibration_image");
+            }
+        }
+
+        RETURN_NOERROR;
+    }
+
+    /// Forwards a blank blob of the full batch size through every instance, which triggers the lazy backend initialization and allocations.
+    tVoid Warmup()
+    {
+        int vecBlobShape[] = { GetMaxBatch(), 3, m_fBlobHeight, m_fBlobWidth };
+        Mat oBlob(4, vecBlobShape, CV_32F, Scalar(0));
+
+        for (auto & pInstance : m_vecNets)
+        {
+            tSharedNet & oShared = *pInstance->pNet;
+            std::lock_guard<std::mutex> oLock(oShared.oMutex);
+            if (oShared.bWarmedUp)
+            {
+                // shared net warmed up by another filter
+                continue;
+            }
+
+            for (tInt32 nIteration = 0; nIteration < m_nWarmupIterations; ++nIteration)
+            {
+                try
+                {
+                    oShared.oNet.setInput(oBlob);
+                    if (m_bImInfo)
+                    {
+                        oShared.oNet.setInput(m_oImInfo, "im_info");
+                    }
+                    oShared.oNet.forward(pInstance->vecOuts, m_vecOutputLayerNames);
+                }
+                catch (cv::Exception & oException)
+                {
+                    LOG_WARNING("Warm-up forward failed: %s", oException.what());
+                    break;
+                }
+            }
+            oShared.bWarmedUp = tTrue;
+        }
+    }
+
+    int GetMaxBatch() const
+    {
+        return IsBatching() ? std::max<tInt32>(m_nBatchSize, 1) : 1;
+    }
+
+    /**
+     * Fills the output pool with tensors of the output layer shape, so the steady state does not need any allocation.
+     * The input blobs belong to the requests, which may be in flight, so they are created once in OnStagePreConnect
+     * with the maximum batch size and padded for smaller batches.
+     */
+    tVoid AllocateBuffers()
+    {
+        int nBatch = GetMaxBatch();
+        int vecBlobShape[] = { nBatch, 3, m_fBlobHeight, m_fBlobWidth };
+
+        m_oOutputPool.SetMaxBuffers(std::max<tInt32>(m_nOutputPoolSize, 0));
+        Net & oDnnNet = m_vecNets[0]->pNet->oNet;
+        try
+        {
+            std::vector<MatShape> vecOutputShapes;
+            for (auto & strLayerName : m_vecOutputLayerNames)
+            {
+                std::vector<MatShape> vecInShapes;
+                std::vector<MatShape> vecOutShapes;
+                oDnnNet.getLayerShapes(MatShape(vecBlobShape, vecBlobShape + 4),
+                    oDnnNet.getLayerId(strLayerName),
+                    vecInShapes,
+                    vecOutShapes);
+                vecOutputShapes.push_back(vecOutShapes.empty() ? MatShape() : vecOutShapes[0]);
+            }
+
+            // same size calculation as in CopyToPool
+            size_t nTotal = vecOutputShapes.empty() ? 0 : total(vecOutputShapes[0]);
+            if (IsStackable(vecOutputShapes))
+            {
+                nTotal = 0;
+                for (auto & oShape : vecOutputShapes)
+                {
+                    nTotal += total(oShape);
+                }
+            }
+
+            if (nTotal > 0)
+            {
+                // hold all buffers at once, otherwise the pool would hand out the same one again
+                std::vector<Mat> vecPreallocated;
+                for (tInt32 nBuffer = 0; nBuffer < m_nOutputPoolSize; ++nBuffer)
+                {
+                    tBool bHit = tFalse;
+                    vecPreallocated.push_back(m_oOutputPool.Acquire(1, static_cast<int>(nTotal / nBatch), CV_32F, bHit));
+                    CountAllocation(!bHit);
+                }
+            }
+        }
+        catch (cv::Exception & oException)
+        {
+            // e.g. nets with additional inputs, the pool is filled with the first frames then
+            LOG_WARNING("Unable to determine the output shape: %s", oException.what());
+        }
+    }
+
+    tVoid CreateBlob(tRequest & oRequest, int nBatch)
+    {
+        int vecBlobShape[] = { nBatch, 3, m_fBlobHeight, m_fBlobWidth };
+
+        const uchar* pBlobData = oRequest.oBlob.data;
+        oRequest.oBlob.create(4, vecBlobShape, CV_32F);
+        CountAllocation(pBlobData != oRequest.oBlob.data);
+        oRequest.oBlob.setTo(Scalar(0));
+        oRequest.nPaddedFrom = 0;
+
+        oRequest.vecGeometry.resize(nBatch);
+    }
+
+    int GetBlobBatch(const tRequest & oRequest) const
+    {
+        return oRequest.oBlob.empty() ? 0 : oRequest.oBlob.size[0];
+    }
+
+    /// Clears the images of the blob not used by this request, a changing blob shape would reshape the net on every forward.
+    tVoid PadBlob(tRequest & oRequest, int nBatch)
+    {
+        if (nBatch < oRequest.nPaddedFrom)
+        {
+            // only the images filled by the previous request
+            float* pBegin = oRequest.oBlob.ptr<float>(nBatch);
+            std::fill(pBegin, pBegin + (oRequest.nPaddedFrom - nBatch) * oRequest.oBlob.step1(0), 0.0f);
+        }
+        oRequest.nPaddedFrom = nBatch;
+    }
+
+    tBlobParameters GetBlobParameters() const
+    {
+        tBlobParameters sParameters;
+        sParameters.oSize = Size(m_fBlobWidth, m_fBlobHeight);
+        sParameters.oMean = Scalar(m_fBlobMeanRed, m_fBlobMeanGreen, m_fBlobMeanBlue);
+        sParameters.fScale = m_fBlobScale;
+        sParameters.bSwapRB = tTrue;
+        sParameters.bLetterbox = m_bBlobLetterbox;
+        return sParameters;
+    }
+
+    /// Resizes, normalizes and transposes the image into the preallocated blob in a single pass.
+    tVoid FillBlob(tRequest & oRequest, const Mat & oImage, int nBatchIndex)
+    {
+        if (oImage.type() == CV_8UC3)
+        {
+            oRequest.vecGeometry[nBatchIndex] = fill_blob(oImage, oRequest.oBlob, nBatchIndex, GetBlobParameters());
+        }
+        else
+        {
+            Mat oColorImage;
+            cvtColor(oImage, oColorImage, COLOR_GRAY2BGR);
+            oRequest.vecGeometry[nBatchIndex] = fill_blob(oColorImage, oRequest.oBlob, nBatchIndex, GetBlobParameters());
+        }
+    }
+
+    tVoid CountAllocation(tBool bAllocated)
+    {
+        if (bAllocated)
+        {
+            set_property<tUInt64>(*this, "allocations", ++m_nAllocations);
+        }
+    }
+
+    /// The outputs belong to the net and are overwritten by the next forward call, so they are copied into a recycled buffer.
+    Mat CopyToPool(const Mat & oOutput)
+    {
+        if (oOutput.empty())
+        {
+            return Mat();
+        }
+
+        tBool bHit = tFalse;
+        Mat oBuffer = m_oOutputPool.Acquire(1, static_cast<int>(oOutput.total()), oOutput.type(), bHit);
+        CountAllocation(!bHit);
+
+        Mat oResult = oBuffer.reshape(1, oOutput.dims, oOutput.size.p);
+        oOutput.copyTo(oResult);
+        return oResult;
+    }
+
+    /// Outputs with rows of the same size (e.g. the YOLO heads) are published as one Mat.
+    static tBool IsStackable(const std::vector<MatShape>& vecShapes)
+    {
+        if (vecShapes.size() < 2)
+        {
+            return tFalse;
+        }
+
+        for (auto & oShape : vecShapes)
+        {
+            if (oShape.size() != 2 || oShape[1] != vecShapes[0][1])
+            {
+                return tFalse;
+            }
+        }
+        return tTrue;
+    }
+
+    /// Stacks the rows of all outputs into one recycled buffer if possible, otherwise only the first output is published.
+    Mat CopyToPool(const std::vector<Mat>& vecOutputs)
+    {
+        std::vector<MatShape> vecShapes;
+        int nRows = 0;
+        for (auto & oOutput : vecOutputs)
+        {
+            vecShapes.push_back(shape(oOutput));
+            nRows += oOutput.rows;
+        }
+
+        if (!IsStackable(vecShapes) || nRows == 0)
+        {
+            return vecOutputs.empty() ? Mat() : CopyToPool(vecOutputs[0]);
+        }
+
+        tBool bHit = tFalse;
+        Mat oBuffer = m_oOutputPool.Acquire(1, nRows * vecOutputs[0].cols, vecOutputs[0].type(), bHit);
+        CountAllocation(!bHit);
+
+        Mat oResult = oBuffer.reshape(1, nRows);
+        int nRow = 0;
+        for (auto & oOutput : vecOutputs)
+        {
+            oOutput.copyTo(oResult.rowRange(nRow, nRow + oOutput.rows));
+            nRow += oOutput.rows;
+        }
+        return oResult;
+    }
+
+    tResult ProcessSample(const iobject_ptr<const ISample>& pSample, object_ptr<const ISample>& pOutSample) override
+    {
+        object_ptr<const IOpenCVSample> pMatSample = pSample;
+        if (!pMatSample || pMatSample->GetMat().empty() || !IsLoaded())
+        {
+            RETURN_NOERROR;
+        }
+
+        Mat oResult;
+        std::vector<std::vector<tDetection>> vecDetections;
+        {
+            tNetInstance & oInstance = *m_vecNets[0];
+            std::lock_guard<std::mutex> oLock(oInstance.pNet->oMutex);
+            tRequest & oRequest = m_vecRequests[0];
+            oRequest.vecEntries = { { 0, pSample } };
+            Infer(oInstance, oRequest);
+            oRequest.vecEntries.clear();
+            oResult = oRequest.vecResults[0];
+            vecDetections.swap(oRequest.vecDetections);
+        }
+
+        // in async mode we are running in a worker thread and not within a trigger
+        RETURN_IF_FAILED(WriteDetections(m_vecDetectionOutputs[0], vecDetections[0], pSample, m_bAsync));
+
+        if (!oResult.empty())
+        {
+            object_ptr<ISample> pNewSample = make_object_ptr<cOpenCVSample>(oResult);
+            pNewSample->SetTime(pSample->GetTime());
+            pOutSample = pNewSample;
+        }
+
+        RETURN_NOERROR;
+    }
+    
+};
+
+class cDNNDetectionFilter : public cFilter
+{
+public:
+    ADTF_CLASS_ID_NAME(cDNNDetectionFilter,
+        "dnn_detection.opencv.videotb.cid",
+        "DNN Detection Filter");
+
+private:
+    cPinReader* m_pInput;
+    cPinWriter* m_pOutput;
+
+    property_variable<tFloat32> m_fScoreThreshold = 0.25f;
+    property_variable<tFloat32> m_fObjectnessThreshold = 0.25f;
+    property_variable<tFloat32> m_fNmsThreshold = 0.45f;
+    property_variable<tInt32> m_nNmsMethod = NMS_Greedy;
+    property_variable<tBool> m_bClassAware = tTrue;
+    property_variable<tInt32> m_nMaxDetections = 100;
+
+    std::vector<tDetection> m_vecDetections;
+
+public:
+    cDNNDetectionFilter()
+    {
+        SetDescription("Filters the detections of the DNN Filter and removes overlapping boxes. "
+                       "Raw YOLO outputs are decoded as well, their boxes are relative to the blob, so letterbox, region of interest and tiles are not corrected.");
+
+        object_ptr<IStreamType> pMatStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
+        m_pInput = CreateInputPin("dnn", pMatStreamType);
+        m_pInput->SetAcceptTypeCallback([](const iobject_ptr<const IStreamType>& pStreamType) -> tResult
+        {
+            cString strMetaType;
+            RETURN_IF_FAILED(pStreamType->GetMetaTypeName(adtf_string_intf(strMetaType)));
+            if (strMetaType != stream_meta_type_mat::MetaTypeName && strMetaType != stream_meta_type_detections::MetaTypeName)
+            {
+                RETURN_ERROR_DESC(ERR_INVALID_TYPE, "Only raw DNN outputs and detections are supported, not %s", strMetaType.GetPtr());
+            }
+            RETURN_NOERROR;
+        });
+
+        object_ptr<IStreamType> pDetectionType = make_object_ptr<cStreamType>(stream_meta_type_detections());
+        m_pOutput = CreateOutputPin("detections", pDetectionType);
+
+        m_fScoreThreshold.SetDescription("Minimum class score of a detection.");
+        RegisterPropertyVariable("score_threshold", m_fScoreThreshold);
+        m_fObjectnessThreshold.SetDescription("Rows of raw YOLO outputs below this objectness are rejected without looking at the class scores.");
+        RegisterPropertyVariable("objectness_threshold", m_fObjectnessThreshold);
+        m_fNmsThreshold.SetDescription("Detections overlapping a better one by more than this intersection over union are removed.");
+        RegisterPropertyVariable("nms_threshold", m_fNmsThreshold);
+        m_nNmsMethod.SetDescription("Greedy is the classic NMS. Fast compares all boxes in a single pass and may suppress slightly more.");
+        m_nNmsMethod.SetValueList({
+            {NMS_Greedy, "greedy"},
+            {NMS_Fast, "fast"},
+            });
+        RegisterPropertyVariable("nms_method", m_nNmsMethod);
+        m_bClassAware.SetDescription("Only detections of the same class suppress each other.");
+        RegisterPropertyVariable("nms_class_aware", m_bClassAware);
+        m_nMaxDetections.SetDescription("Maximum number of detections per frame, 0 for no limit.");
+        RegisterPropertyVariable("max_detections", m_nMaxDetections);
+    }
+
+    tResult ProcessInput(ISampleReader* pReader,
+        const iobject_ptr<const ISample>& pSample) override
+    {
+        m_vecDetections.clear();
+
+        object_ptr<const IOpenCVSample> pMatSample = pSample;
+        if (pMatSample)
+        {
+            const Mat & oOutput = pMatSample->GetMat();
+            if (oOutput.empty())
+            {
+                RETURN_NOERROR;
+            }
+
+            const int nCols = oOutput.size[oOutput.dims - 1];
+            if (oOutput.type() != CV_32F || nCols <= 5 || !oOutput.isContinuous())
+            {
+                RETURN_ERROR_DESC(ERR_INVALID_TYPE, "Expected continuous float rows of boxes, objectness and class scores");
+            }
+
+            Mat oRows(static_cast<int>(oOutput.total() / nCols), nCols, CV_32F, const_cast<uchar*>(oOutput.ptr()));
+            decode_region_rows(oRows, m_fObjectnessThreshold, m_fScoreThreshold, m_vecDetections);
+        }
+        else
+        {
+            RETURN_IF_FAILED(get_detections(m_vecDetections, *pSample.Get()));
+
+            const tFloat32 fScoreThreshold = m_fScoreThreshold;
+            m_vecDetections.erase(std::remove_if(m_vecDetections.begin(), m_vecDetections.end(), [fScoreThreshold](const tDetection & sDetection)
+            {
+                return sDetection.fScore < fScoreThreshold;
+            }), m_vecDetections.end());
+        }
+
+        suppress_detections(m_vecDetections, m_fNmsThreshold, static_cast<tNmsMethod>(static_cast<tInt32>(m_nNmsMethod)),
+            m_bClassAware, m_nMaxDetections);
+
+        object_ptr<ISample> pOutSample;
+        RETURN_IF_FAILED(create_detection_sample(pOutSample, m_vecDetections));
+        pOutSample->SetTime(pSample->GetTime());
+        RETURN_IF_FAILED(m_pOutput->Write(pOutSample));
+
+        RETURN_NOERROR;
+    }
+};
+
+class cDNNOpenCVPlotFilter : public cOpenCVBaseFilter
+{
+public:
+    ADTF_CLASS_ID_NAME(cDNNOpenCVPlotFilter,
+        "dnn_plot.opencv.videotb.cid",
+        "DNN Plot Filter");
+
+public:
+
+    cDNNOpenCVPlotFilter()
+    {
+        SetDescription("Simple DNN Result Plot");
+        object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_detections());
+        m_pDNNPin = CreateInputPin("dnn", pStreamType);
+
+        m_nSyncTolerance.SetDescription("Maximum difference in ms between the sample times of a frame and its detections.");
+        RegisterPropertyVariable("sync_tolerance", m_nSyncTolerance);
+        m_nMaxLatency.SetDescription("Maximum time in ms (sample time) a frame waits for its detections.");
+        RegisterPropertyVariable("sync_max_latency", m_nMaxLatency);
+        m_nLatencyPolicy.SetDescription("What happens to a frame whose detections did not arrive within the maximum latency.");
+        m_nLatencyPolicy.SetValueList({
+            {LP_EmitWithoutDetections, "emit_without_detections"},
+            {LP_DropFrame, "drop_frame"},
+            });
+        RegisterPropertyVariable("sync_latency_policy", m_nLatencyPolicy);
+        m_nBufferSize.SetDescription("Number of frames and detections buffered for the synchronization.");
+        RegisterPropertyVariable("sync_buffer_size", m_nBufferSize);
+        set_property<tUInt64>(*this, "sync_dropped_frames", 0);
+        set_property<tUInt64>(*this, "sync_unmatched_frames", 0);
+        set_property<tUInt64>(*this, "sync_dropped_detections", 0);
+    }
+
+    ~cDNNOpenCVPlotFilter()
+    {
+
+    }
+
+    tResult Start() override
+    {
+        m_oDetectionRing.Reset(std::max<tInt32>(m_nBufferSize, 1));
+        m_oSynchronizer.Configure(static_cast<tTimeStamp>(m_nSyncTolerance) * 1000, static_cast<tTimeStamp>(m_nMaxLatency) * 1000,
+            std::max<tInt32>(m_nBufferSize, 1), static_cast<tLatencyPolicy>(static_cast<tInt32>(m_nLatencyPolicy)));
+        m_oSynchronizer.Reset();
+
+        return cOpenCVBaseFilter::Start();
+    }
+
+    tResult Stop() override
+    {
+        UpdateSyncStatistics();
+        m_oSynchronizer.Reset();
+
+        return cOpenCVBaseFilter::Stop();
+    }
+
+    /**
+     * The detections are handed over lock free to the thread of the frames, which pairs both by sample time.
+     * Frames wait until their detections arrived, a later detection arrived or the maximum latency elapsed.
+     */
+    tResult ProcessInput(ISampleReader* pReader,
+        const iobject_ptr<const ISample>& pSample) override
+    {
+        if (pReader == m_pDNNPin)
+        {
+            if (!m_oDetectionRing.Push(pSample))
+            {
+                LOG_DUMP("Synchronization buffer full, detections dropped");
+            }
+            RETURN_NOERROR;
+        }
+
+        m_oSynchronizer.AddFrame(pSample);
+
+        object_ptr<const ISample> pDetections;
+        while (m_oDetectionRing.Pop(pDetections))
+        {
+            m_oSynchronizer.AddDetections(pDetections);
+        }
+
+        auto fnEmit = [this](const object_ptr<const ISample>& pFrame, const object_ptr<const ISample>& pFrameDetections)
+        {
+            return EmitFrame(pFrame, pFrameDetections);
+        };
+        const tUInt64 nMissedFrames = m_oSynchronizer.GetDroppedFrames() + m_oSynchronizer.GetUnmatchedFrames();
+        RETURN_IF_FAILED(m_oSynchronizer.Emit(pSample->GetTime(), fnEmit));
+        if (m_oSynchronizer.GetDroppedFrames() + m_oSynchronizer.GetUnmatchedFrames() != nMissedFrames)
+        {
+            UpdateSyncStatistics();
+        }
+
+        RETURN_NOERROR;
+    }
+
+    tResult EmitFrame(const object_ptr<const ISample>& pFrame, const object_ptr<const ISample>& pDetections)
+    {
+        m_vecDetections.clear();
+        if (pDetections && IS_FAILED(get_detections(m_vecDetections, *pDetections.Get())))
+        {
+            LOG_WARNING("Invalid detection sample");
+            m_vecDetections.clear();
+        }
+
+        object_ptr<const ISample> pOutSample;
+        RETURN_IF_FAILED(ProcessSample(pFrame, pOutSample));
+        if (pOutSample)
+        {
+            m_pOutput->Write(pOutSample);
+        }
+        RETURN_NOERROR;
+    }
+
+    tVoid UpdateSyncStatistics()
+    {
+        set_property<tUInt64>(*this, "sync_dropped_frames", m_oSynchronizer.GetDroppedFrames());
+        set_property<tUInt64>(*this, "sync_unmatched_frames", m_oSynchronizer.GetUnmatchedFrames());
+        set_property<tUInt64>(*this, "sync_dropped_detections", m_oDetectionRing.GetDropped());
+    }
+
+    tResult ProcessMat(const cv::Mat & oMat, cv::Mat & oResult) override
+    {
+        // the input frame is shared with other filters (e.g. the DNN filter), so draw into a copy
+        if (oResult.empty())
+        {
+            oResult = oMat.clone();
+        }
+        else
+        {
+            oMat.copyTo(oResult);
+        }
+
+        for (auto & sDetection : m_vecDetections)
+        {
+            DrawPred(sDetection.nClassId, sDetection.fScore,
+                static_cast<int>(sDetection.fLeft * oMat.cols),
+                static_cast<int>(sDetection.fTop * oMat.rows),
+                static_cast<int>((sDetection.fLeft + sDetection.fWidth) * oMat.cols),
+                static_cast<int>((sDetection.fTop + sDetection.fHeight) * oMat.rows),
+                oResult);
+        }
+        RETURN_NOERROR;
+    }
+
+    void DrawPred(int classId, float conf, int left, int top, int right, int bottom, Mat& frame)
+    {
+        rectangle(frame, Point(left, top), Point(right, bottom), Scalar(0, 255, 0), 2);
+
+        std::string label = format("%.2f", conf);
+        if (classId >= 0 && classId < (int)lstClasses.size())
+        {
+            label = lstClasses[classId] + ": " + label;
+        }
+        else
+        {
+            // no class file or one which does not match the model
+            label = format("%d: ", classId) + label;
+        }
+
+        int baseLine;
+        Size labelSize = getTextSize(label, FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+
+        top = max(top, labelSize.height);
+        rectangle(frame, Point(left, top - labelSize.height),
+            Point(left + labelSize.width, top + baseLine), Scalar::all(255), FILLED);
+        putText(frame, label, Point(left, top), FONT_HERSHEY_SIMPLEX, 0.5, Scalar());
+    }
+
+
+private:
+    cPinReader* m_pDNNPin;
+
+    property_variable<tInt32> m_nSyncTolerance = 5;
+    property_variable<tInt32> m_nMaxLatency = 200;
+    property_variable<tInt32> m_nLatencyPolicy = LP_EmitWithoutDetections;
+    property_variable<tInt32> m_nBufferSize = 16;
+
+    // written by the thread of the dnn pin, read by the thread of the frames
+    cSpscRing<object_ptr<const ISample>> m_oDetectionRing;
+    // only accessed by the thread of the frames
+    cFrameSynchronizer m_oSynchronizer;
+    std::vector<tDetection> m_vecDetections;
 
     std::vector<std::string> lstClasses = { "person","bicycle","car","motorbike","aeroplane","bus","train","truck","boat","traffic light","fire hydrant","stop sign","parking meter","bench","bird","cat","dog","horse","sheep","cow","elephant","bear","zebra","giraffe","backpack","umbrella","handbag","tie","suitcase","frisbee","skis","snowboard","sports ball","kite","baseball bat","baseball glove","skateboard","surfboard","tennis racket","bottle","wine glass","cup","fork","knife","spoon","bowl","banana","apple","sandwich","orange","broccoli","carrot","hot dog","pizza","donut","cake","chair","sofa","pottedplant","bed","diningtable","toilet","tvmonitor","laptop","mouse","remote","keyboard","cell phone","microwave","oven","toaster","sink","refrigerator","book","clock","vase","scissors","teddy bear","hair drier","toothbrush" };
 
@@ -327,4 +2114,6 @@ private:
 
 ADTF_PLUGIN("OpenCV DNN Filter Plugin",
     cDNNOpenCVFilter,
-    cDNNOpenCVPlotFilter)
\ No newline at end of file
+    cDNNDetectionFilter,
+    cDNNOpenCVPlotFilter,
+    cDNNModelCacheService)
\ No newline at end of file
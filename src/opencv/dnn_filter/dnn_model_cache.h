@@ -0,0 +1,197 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <adtfsystemsdk/adtf_systemsdk.h>
+
+#include <opencv2/dnn.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/// A net which may be used by several filters, every call on the net needs to lock the mutex.
+struct tSharedNet
+{
+    cv::dnn::Net oNet;
+    std::mutex oMutex;
+    /// guarded by oMutex
+    tBool bWarmedUp = tFalse;
+};
+
+enum tPrecision : tInt32
+{
+    PR_FP32 = 0,
+    PR_FP16 = 1,
+    PR_INT8 = 2
+};
+
+struct tDNNModelKey
+{
+    std::string strConfig;
+    std::string strModule;
+    tInt32 nBackend;
+    tInt32 nTarget;
+    /// PR_INT8 quantizes the net on load if oCalibrationBlob is set, otherwise the model has to be quantized already
+    tInt32 nPrecision;
+    /// identifies the calibration data, part of the cache key
+    std::string strCalibration;
+    cv::Mat oCalibrationBlob;
+    /// input shape, a net shared by filters with different blobs would be reshaped on every forward
+    tInt32 nBlobWidth;
+    tInt32 nBlobHeight;
+    tInt32 nBatch;
+};
+
+/// Reads the net, quantizes it if requested and selects backend and target.
+inline tResult load_net(const tDNNModelKey & sKey, cv::dnn::Net & oNet)
+{
+    try
+    {
+        oNet = cv::dnn::readNet(sKey.strModule, sKey.strConfig);
+        if (!oNet.empty() && sKey.nPrecision == PR_INT8 && !sKey.oCalibrationBlob.empty())
+        {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+            // per channel int8 weights, the inputs and outputs stay float so the pre- and postprocessing do not change
+            oNet = oNet.quantize(sKey.oCalibrationBlob, CV_32F, CV_32F);
+#else
+            RETURN_ERROR_DESC(ERR_NOT_SUPPORTED, "Quantization on load needs OpenCV 4.6 or newer, use a quantized model instead");
+#endif
+        }
+    }
+    catch (cv::Exception & oException)
+    {
+        RETURN_ERROR_DESC(ERR_FAILED, "Failed to created DNN Net %s", oException.what());
+    }
+    if (oNet.empty())
+    {
+        RETURN_ERROR_DESC(ERR_NOT_READY, "Error while creating Dnn net");
+    }
+
+    oNet.setPreferableBackend(sKey.nBackend);
+    oNet.setPreferableTarget(sKey.nTarget);
+    RETURN_NOERROR;
+}
+
+/**
+ * Parsed DNN models shared by all filters of the session.
+ * The interface passes STL types, so it may only be used from within the plugin of the service.
+ */
+class IDNNModelCache : public adtf::ucom::IObject
+{
+public:
+    ADTF_IID(IDNNModelCache, "dnn_model_cache.opencv.videotb.iid");
+
+public:
+    /**
+     * Returns nCount nets of the model and loads the ones which are not cached yet.
+     * Filters asking for the same model get the same nets, so nets with the same index are shared.
+     */
+    virtual tResult GetNets(const tDNNModelKey & sKey, tSize nCount, std::vector<std::shared_ptr<tSharedNet>>& vecNets) = 0;
+};
+
+/// Size and modification time of the file, empty if the file does not exist. Cheap enough to be checked on every load.
+inline std::string file_stamp(const std::string & strPath)
+{
+    adtf::util::cFileSystem::tFileInfo sInfo;
+    if (IS_FAILED(adtf::util::cFileSystem::GetFileInfo(adtf::util::cFilename(strPath.c_str()), &sInfo)))
+    {
+        return std::string();
+    }
+    return std::to_string(static_cast<tUInt64>(sInfo.nSize)) + "@" + std::to_string(static_cast<tInt64>(sInfo.nLastWriteTime));
+}
+
+class cDNNModelCacheService : public adtf::ucom::object<adtf::system::cADTFService, IDNNModelCache>
+{
+public:
+    ADTF_CLASS_ID_NAME(cDNNModelCacheService,
+        "dnn_model_cache.opencv.videotb.cid",
+        "DNN Model Cache Service");
+
+    ADTF_CLASS_DEPENDENCIES(
+        PROVIDE_INTERFACE(IDNNModelCache));
+
+    cDNNModelCacheService()
+    {
+        SetDefaultRunlevel(adtf::base::tADTFRunLevel::RL_Session);
+        SetDescription("Use this System Service to share the parsed models between all DNN Filters using the same model files, backend, target and blob size.");
+    }
+
+    tResult GetNets(const tDNNModelKey & sKey, tSize nCount, std::vector<std::shared_ptr<tSharedNet>>& vecNets) override
+    {
+        // size and modification time are part of the key, so a model replaced on disk is loaded again
+        const std::string strKey = adtf::util::cString::Format("%s|%s|%d|%d|%d|%s|%dx%dx%d|%s|%s",
+            sKey.strConfig.c_str(), sKey.strModule.c_str(), sKey.nBackend, sKey.nTarget, sKey.nPrecision, sKey.strCalibration.c_str(),
+            sKey.nBlobWidth, sKey.nBlobHeight, sKey.nBatch,
+            file_stamp(sKey.strConfig).c_str(),
+            file_stamp(sKey.strModule).c_str()).GetPtr();
+
+        std::vector<std::shared_ptr<tSharedNet>> vecEntries;
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            std::vector<std::shared_ptr<tSharedNet>>& vecCached = m_mapNets[strKey];
+            while (vecCached.size() < nCount)
+            {
+                vecCached.push_back(std::make_shared<tSharedNet>());
+            }
+            vecEntries.assign(vecCached.begin(), vecCached.begin() + nCount);
+        }
+
+        // loaded outside of the cache lock, so filters using other models do not wait
+        for (auto & pNet : vecEntries)
+        {
+            std::lock_guard<std::mutex> oLock(pNet->oMutex);
+            if (!pNet->oNet.empty())
+            {
+                continue;
+            }
+
+            RETURN_IF_FAILED(load_net(sKey, pNet->oNet));
+            LOG_INFO("Cached DNN %s", sKey.strModule.c_str());
+        }
+
+        vecNets = vecEntries;
+        RETURN_NOERROR;
+    }
+
+    tResult ServiceShutdown() override
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_mapNets.clear();
+        RETURN_NOERROR;
+    }
+
+private:
+    std::mutex m_oMutex;
+    std::map<std::string, std::vector<std::shared_ptr<tSharedNet>>> m_mapNets;
+};
+
+}
+}
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <opencv_base_filter/detection.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Cheap change detector gating the DNN. Compares a downscaled grey version of every frame with a
+ * running average background and reports the bounding box of the changed pixels.
+ * Not thread safe, use one instance per camera.
+ */
+class cMotionDetector
+{
+public:
+    /// Width of the grey image the frames are compared at, the height keeps the aspect ratio.
+    tInt32 m_nWidth = 160;
+    /// Minimum difference of a pixel to the background in grey levels.
+    tFloat32 m_fThreshold = 25.0f;
+    /// Fraction of the pixels which need to change to report motion.
+    tFloat32 m_fMinArea = 0.001f;
+    /// Weight of the current frame in the running average background.
+    tFloat32 m_fLearningRate = 0.05f;
+
+    tVoid Reset()
+    {
+        m_oBackground.release();
+    }
+
+    /**
+     * Compares the frame with the background and updates the background afterwards.
+     * The first frame after a reset always counts as motion of the whole frame.
+     * @param [in] oFrame BGR or grey frame
+     * @param [out] oMask changed pixels (255) at the downscaled size, a new Mat for every call
+     * @param [out] oRoi bounding box of the changed pixels in frame coordinates
+     * @return tTrue if enough pixels changed
+     */
+    tBool Detect(const cv::Mat & oFrame, cv::Mat & oMask, cv::Rect & oRoi)
+    {
+        const int nWidth = std::min<int>(std::max<int>(m_nWidth, 8), oFrame.cols);
+        const int nHeight = std::max(1, oFrame.rows * nWidth / oFrame.cols);
+
+        if (oFrame.channels() == 1)
+        {
+            cv::resize(oFrame, m_oSmall, cv::Size(nWidth, nHeight), 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            // downscale first, so the colour conversion only touches the small image
+            cv::resize(oFrame, m_oSmallColor, cv::Size(nWidth, nHeight), 0, 0, cv::INTER_AREA);
+            cv::cvtColor(m_oSmallColor, m_oSmall, oFrame.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+        }
+        // sensor noise would otherwise show up as motion
+        cv::GaussianBlur(m_oSmall, m_oSmall, cv::Size(5, 5), 0);
+
+        if (m_oBackground.size() != m_oSmall.size())
+        {
+            m_oSmall.convertTo(m_oBackground, CV_32F);
+            oMask = cv::Mat(m_oSmall.size(), CV_8U, cv::Scalar(255));
+            oRoi = cv::Rect(0, 0, oFrame.cols, oFrame.rows);
+            return tTrue;
+        }
+
+        m_oBackground.convertTo(m_oBackground8, CV_8U);
+        cv::absdiff(m_oSmall, m_oBackground8, m_oDifference);
+        cv::threshold(m_oDifference, oMask, m_fThreshold, 255, cv::THRESH_BINARY);
+        // joins the fragments of one moving object
+        cv::dilate(oMask, oMask, cv::Mat(), cv::Point(-1, -1), 2);
+        cv::accumulateWeighted(m_oSmall, m_oBackground, m_fLearningRate);
+
+        const int nChanged = cv::countNonZero(oMask);
+        if (nChanged < std::max(1, static_cast<int>(m_fMinArea * oMask.total())))
+        {
+            oRoi = cv::Rect();
+            return tFalse;
+        }
+
+        const cv::Rect oSmallRoi = cv::boundingRect(oMask);
+        const double fScaleX = static_cast<double>(oFrame.cols) / nWidth;
+        const double fScaleY = static_cast<double>(oFrame.rows) / nHeight;
+        oRoi = cv::Rect(cvFloor(oSmallRoi.x * fScaleX), cvFloor(oSmallRoi.y * fScaleY),
+            cvCeil(oSmallRoi.width * fScaleX), cvCeil(oSmallRoi.height * fScaleY));
+        return tTrue;
+    }
+
+private:
+    cv::Mat m_oSmallColor;
+    cv::Mat m_oSmall;
+    cv::Mat m_oBackground;
+    cv::Mat m_oBackground8;
+    cv::Mat m_oDifference;
+};
+
+/**
+ * Grows a motion box by a quarter of its size on every side, so objects which only moved partly are
+ * still inferred completely. Boxes covering most of the frame are widened to the whole frame.
+ */
+inline cv::Rect expand_roi(const cv::Rect & oRoi, const cv::Size & oFrameSize)
+{
+    const cv::Rect oFrame(cv::Point(0, 0), oFrameSize);
+    const int nMarginX = std::max(16, oRoi.width / 4);
+    const int nMarginY = std::max(16, oRoi.height / 4);
+    cv::Rect oExpanded = cv::Rect(oRoi.x - nMarginX, oRoi.y - nMarginY, oRoi.width + 2 * nMarginX, oRoi.height + 2 * nMarginY) & oFrame;
+    if (oExpanded.area() * 2 > oFrame.area())
+    {
+        oExpanded = oFrame;
+    }
+    return oExpanded;
+}
+
+/// Maps a detection normalized to a region of the frame to frame normalized coordinates.
+inline tVoid roi_to_frame(tDetection & sDetection, const cv::Rect & oRoi, const cv::Size & oFrameSize)
+{
+    sDetection.fLeft = (oRoi.x + sDetection.fLeft * oRoi.width) / oFrameSize.width;
+    sDetection.fTop = (oRoi.y + sDetection.fTop * oRoi.height) / oFrameSize.height;
+    sDetection.fWidth = sDetection.fWidth * oRoi.width / oFrameSize.width;
+    sDetection.fHeight = sDetection.fHeight * oRoi.height / oFrameSize.height;
+}
+
+}
+}
+}
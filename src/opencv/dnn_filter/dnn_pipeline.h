@@ -0,0 +1,346 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <opencv_base_filter/detection.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+/**
+ * Thread safe FIFO connecting two stages of the DNN pipeline. The requests circulate between
+ * the channels, so the number of requests in flight is bounded by the number of requests and
+ * the channels themselves do not need a capacity.
+ */
+template <typename T>
+class cRequestChannel
+{
+public:
+    tVoid Push(T oRequest)
+    {
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            m_lstRequests.push_back(std::move(oRequest));
+        }
+        m_oCondition.notify_one();
+    }
+
+    /// @return tFalse if nothing arrived within tmTimeout or the channel is closed.
+    tBool Pop(T& oRequest, std::chrono::milliseconds tmTimeout)
+    {
+        std::unique_lock<std::mutex> oLock(m_oMutex);
+        if (!m_oCondition.wait_for(oLock, tmTimeout, [this] { return m_bClosed || !m_lstRequests.empty(); }) || m_bClosed)
+        {
+            return tFalse;
+        }
+
+        oRequest = std::move(m_lstRequests.front());
+        m_lstRequests.pop_front();
+        return tTrue;
+    }
+
+    /// Wakes up all waiting stages, Pop fails until Open is called.
+    tVoid Close()
+    {
+        {
+            std::lock_guard<std::mutex> oLock(m_oMutex);
+            m_bClosed = tTrue;
+        }
+        m_oCondition.notify_all();
+    }
+
+    tBool IsClosed()
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_bClosed;
+    }
+
+    tVoid Open()
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_lstRequests.clear();
+        m_bClosed = tFalse;
+    }
+
+private:
+    std::mutex m_oMutex;
+    std::condition_variable m_oCondition;
+    std::deque<T> m_lstRequests;
+    tBool m_bClosed = tFalse;
+};
+
+/**
+ * Hands the detections and results of one input on in the order the frames arrived, whichever thread finished them.
+ * Frames skipped by the rate governor or the motion gating take their place in the order as well and get
+ * the detections of the last inferred frame before them. The emit function is called with the internal
+ * lock held, so the output pins are written by one thread at a time and never out of order.
+ */
+class cDetectionSequencer
+{
+public:
+    /// pResult is the raw net output of an inferred frame, empty for skipped frames
+    typedef std::function<tVoid(const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame,
+        const std::vector<tDetection>& vecDetections,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pResult)> tEmitFunction;
+
+public:
+    /// Drops all pending frames and the last detections, sequence numbers start at 0 again.
+    tVoid Reset()
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_mapPending.clear();
+        m_vecLastDetections.clear();
+        m_nNextSequence = 0;
+        m_nNextEmit = 0;
+    }
+
+    /// @return the sequence number of the next frame, only called by the thread receiving the frames
+    tUInt64 Next()
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_nNextSequence++;
+    }
+
+    /// Stores the detections and the result of an inferred frame, the result may be empty.
+    tVoid Complete(tUInt64 nSequence, const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame,
+        const std::vector<tDetection>& vecDetections, const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pResult,
+        const tEmitFunction& fnEmit)
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Store(nSequence, { pFrame, vecDetections, pResult, FK_Inferred }, fnEmit);
+    }
+
+    /// Marks a skipped frame, it is emitted with the detections of the last inferred frame before it.
+    tVoid PassThrough(tUInt64 nSequence, const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame,
+        const tEmitFunction& fnEmit)
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Store(nSequence, { pFrame, std::vector<tDetection>(), adtf::ucom::object_ptr<const adtf::streaming::ISample>(), FK_PassThrough }, fnEmit);
+    }
+
+    /// Marks a frame without detections, so the following ones do not wait for it.
+    tVoid Drop(tUInt64 nSequence, const tEmitFunction& fnEmit)
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        Store(nSequence, { adtf::ucom::object_ptr<const adtf::streaming::ISample>(), std::vector<tDetection>(),
+            adtf::ucom::object_ptr<const adtf::streaming::ISample>(), FK_Dropped }, fnEmit);
+    }
+
+    tSize GetPending() const
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        return m_mapPending.size();
+    }
+
+private:
+    enum tFrameKind
+    {
+        FK_Inferred,
+        FK_PassThrough,
+        FK_Dropped
+    };
+
+    struct tFrame
+    {
+        adtf::ucom::object_ptr<const adtf::streaming::ISample> pFrame;
+        std::vector<tDetection> vecDetections;
+        adtf::ucom::object_ptr<const adtf::streaming::ISample> pResult;
+        tFrameKind eKind;
+    };
+
+    tVoid Store(tUInt64 nSequence, tFrame && sFrame, const tEmitFunction& fnEmit)
+    {
+        if (nSequence < m_nNextEmit)
+        {
+            // outdated frame of a previous run
+            return;
+        }
+
+        m_mapPending[nSequence] = std::move(sFrame);
+        for (auto itPending = m_mapPending.begin();
+             itPending != m_mapPending.end() && itPending->first == m_nNextEmit;
+             itPending = m_mapPending.erase(itPending), ++m_nNextEmit)
+        {
+            tFrame & sPending = itPending->second;
+            if (sPending.eKind == FK_Inferred)
+            {
+                m_vecLastDetections.swap(sPending.vecDetections);
+                fnEmit(sPending.pFrame, m_vecLastDetections, sPending.pResult);
+            }
+            else if (sPending.eKind == FK_PassThrough)
+            {
+                fnEmit(sPending.pFrame, m_vecLastDetections, sPending.pResult);
+            }
+        }
+    }
+
+private:
+    mutable std::mutex m_oMutex;
+    std::map<tUInt64, tFrame> m_mapPending;
+    std::vector<tDetection> m_vecLastDetections;
+    tUInt64 m_nNextSequence = 0;
+    tUInt64 m_nNextEmit = 0;
+};
+
+enum tLatencyPolicy : tInt32
+{
+    LP_EmitWithoutDetections = 0,
+    LP_DropFrame = 1
+};
+
+/**
+ * Pairs frames with the detections of the same sample time, both arrive in the order of their sample times.
+ * Frames wait until their detections arrived, a later detection arrived or the maximum latency elapsed.
+ * Not thread safe, only used by the thread receiving the frames.
+ */
+class cFrameSynchronizer
+{
+public:
+    typedef std::function<tResult(const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pDetections)> tEmitFunction;
+
+public:
+    /**
+     * @param [in] tmTolerance maximum difference between the sample times of a frame and its detections
+     * @param [in] tmMaxLatency maximum sample time a frame waits for its detections
+     * @param [in] nMaxFrames maximum number of waiting frames
+     * @param [in] ePolicy what happens to a frame whose detections did not arrive in time
+     */
+    tVoid Configure(tTimeStamp tmTolerance, tTimeStamp tmMaxLatency, tSize nMaxFrames, tLatencyPolicy ePolicy)
+    {
+        m_tmTolerance = tmTolerance;
+        m_tmMaxLatency = tmMaxLatency;
+        m_nMaxFrames = std::max<tSize>(nMaxFrames, 1);
+        m_ePolicy = ePolicy;
+    }
+
+    /// Drops the waiting frames and detections and resets the counters.
+    tVoid Reset()
+    {
+        m_lstPendingFrames.clear();
+        m_lstDetections.clear();
+        m_nDroppedFrames = 0;
+        m_nUnmatchedFrames = 0;
+    }
+
+    tVoid AddFrame(const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame)
+    {
+        m_lstPendingFrames.push_back(pFrame);
+    }
+
+    tVoid AddDetections(const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pDetections)
+    {
+        m_lstDetections.push_back(pDetections);
+    }
+
+    /**
+     * Emits all frames which do not need to wait any longer, frames without detections get an empty pointer.
+     * @param [in] tmNewest sample time of the newest frame
+     */
+    tResult Emit(tTimeStamp tmNewest, const tEmitFunction& fnEmit)
+    {
+        while (!m_lstPendingFrames.empty())
+        {
+            const adtf::ucom::object_ptr<const adtf::streaming::ISample> pFrame = m_lstPendingFrames.front();
+            const tTimeStamp tmFrame = pFrame->GetTime();
+
+            // detections of frames already emitted or dropped
+            while (!m_lstDetections.empty() && m_lstDetections.front()->GetTime() < tmFrame - m_tmTolerance)
+            {
+                m_lstDetections.pop_front();
+            }
+
+            if (!m_lstDetections.empty() && m_lstDetections.front()->GetTime() <= tmFrame + m_tmTolerance)
+            {
+                const adtf::ucom::object_ptr<const adtf::streaming::ISample> pDetections = m_lstDetections.front();
+                m_lstDetections.pop_front();
+                m_lstPendingFrames.pop_front();
+                RETURN_IF_FAILED(fnEmit(pFrame, pDetections));
+                continue;
+            }
+
+            if (!m_lstDetections.empty())
+            {
+                // the net skipped this frame, its detections will never arrive
+                ++m_nUnmatchedFrames;
+            }
+            else if (tmNewest - tmFrame > m_tmMaxLatency || m_lstPendingFrames.size() > m_nMaxFrames)
+            {
+                if (m_ePolicy == LP_DropFrame)
+                {
+                    ++m_nDroppedFrames;
+                    m_lstPendingFrames.pop_front();
+                    continue;
+                }
+                ++m_nUnmatchedFrames;
+            }
+            else
+            {
+                break;
+            }
+
+            m_lstPendingFrames.pop_front();
+            RETURN_IF_FAILED(fnEmit(pFrame, adtf::ucom::object_ptr<const adtf::streaming::ISample>()));
+        }
+
+        RETURN_NOERROR;
+    }
+
+    tUInt64 GetDroppedFrames() const
+    {
+        return m_nDroppedFrames;
+    }
+
+    tUInt64 GetUnmatchedFrames() const
+    {
+        return m_nUnmatchedFrames;
+    }
+
+    tSize GetPendingFrames() const
+    {
+        return m_lstPendingFrames.size();
+    }
+
+private:
+    tTimeStamp m_tmTolerance = 0;
+    tTimeStamp m_tmMaxLatency = 0;
+    tSize m_nMaxFrames = 1;
+    tLatencyPolicy m_ePolicy = LP_EmitWithoutDetections;
+    std::deque<adtf::ucom::object_ptr<const adtf::streaming::ISample>> m_lstPendingFrames;
+    std::deque<adtf::ucom::object_ptr<const adtf::streaming::ISample>> m_lstDetections;
+    tUInt64 m_nDroppedFrames = 0;
+    tUInt64 m_nUnmatchedFrames = 0;
+};
+
+}
+}
+}
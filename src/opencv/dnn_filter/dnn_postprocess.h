@@ -0,0 +1,191 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <opencv_base_filter/detection.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+enum tNmsMethod
+{
+    /// classic greedy suppression, a suppressed box does not suppress others
+    NMS_Greedy = 0,
+    /// Fast NMS, every box is compared against all higher scored ones in one pass (suppressed ones included)
+    NMS_Fast = 1
+};
+
+/// Maximum of nCount floats, vectorized with the OpenCV universal intrinsics.
+inline float max_value(const float* pValues, int nCount)
+{
+    int i = 0;
+    float fMax = -FLT_MAX;
+#if CV_SIMD
+    if (nCount >= cv::v_float32::nlanes)
+    {
+        cv::v_float32 vMax = cv::vx_load(pValues);
+        for (i = cv::v_float32::nlanes; i <= nCount - cv::v_float32::nlanes; i += cv::v_float32::nlanes)
+        {
+            vMax = cv::v_max(vMax, cv::vx_load(pValues + i));
+        }
+        fMax = cv::v_reduce_max(vMax);
+    }
+#endif
+    for (; i < nCount; ++i)
+    {
+        fMax = std::max(fMax, pValues[i]);
+    }
+    return fMax;
+}
+
+/**
+ * Decodes YOLO region rows (center x, center y, width, height, objectness, class scores).
+ * Rows below the objectness threshold are rejected before their class scores are touched,
+ * the class scores of the other rows are searched with a vectorized maximum.
+ * The boxes keep the coordinate system of the rows (normalized to the blob).
+ */
+inline tVoid decode_region_rows(const cv::Mat & oRows, tFloat32 fObjectnessThreshold, tFloat32 fScoreThreshold, std::vector<tDetection>& vecDetections)
+{
+    CV_Assert(oRows.type() == CV_32F && oRows.dims == 2 && oRows.cols > 5);
+
+    const int nClasses = oRows.cols - 5;
+    for (int nRow = 0; nRow < oRows.rows; ++nRow)
+    {
+        const float* pRow = oRows.ptr<float>(nRow);
+        if (pRow[4] < fObjectnessThreshold)
+        {
+            continue;
+        }
+
+        const float* pScores = pRow + 5;
+        const float fScore = max_value(pScores, nClasses);
+        if (fScore < fScoreThreshold)
+        {
+            continue;
+        }
+
+        const int nClassId = static_cast<int>(std::find(pScores, pScores + nClasses, fScore) - pScores);
+        vecDetections.push_back({ pRow[0] - pRow[2] / 2, pRow[1] - pRow[3] / 2, pRow[2], pRow[3], nClassId, fScore });
+    }
+}
+
+inline tFloat32 intersection_over_union(const tDetection & sFirst, const tDetection & sSecond)
+{
+    const tFloat32 fWidth = std::min(sFirst.fLeft + sFirst.fWidth, sSecond.fLeft + sSecond.fWidth) - std::max(sFirst.fLeft, sSecond.fLeft);
+    const tFloat32 fHeight = std::min(sFirst.fTop + sFirst.fHeight, sSecond.fTop + sSecond.fHeight) - std::max(sFirst.fTop, sSecond.fTop);
+    if (fWidth <= 0.0f || fHeight <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    const tFloat32 fIntersection = fWidth * fHeight;
+    return fIntersection / (sFirst.fWidth * sFirst.fHeight + sSecond.fWidth * sSecond.fHeight - fIntersection);
+}
+
+/**
+ * Removes overlapping detections, the result is sorted by descending score.
+ * @param [in,out] vecDetections the detections to filter
+ * @param [in] fIouThreshold detections overlapping a better one by more than this are removed
+ * @param [in] eMethod greedy or fast suppression
+ * @param [in] bClassAware only detections of the same class suppress each other
+ * @param [in] nTopK maximum number of detections kept, 0 for no limit
+ */
+inline tVoid suppress_detections(std::vector<tDetection>& vecDetections, tFloat32 fIouThreshold, tNmsMethod eMethod, tBool bClassAware, tInt32 nTopK)
+{
+    if (vecDetections.empty())
+    {
+        return;
+    }
+
+    std::vector<int> vecKeep;
+    if (eMethod == NMS_Greedy)
+    {
+        // shift the boxes of every class apart, so one NMSBoxes call does not mix the classes
+        std::vector<cv::Rect2d> vecBoxes;
+        std::vector<float> vecScores;
+        for (auto & sDetection : vecDetections)
+        {
+            const double fShift = bClassAware ? sDetection.nClassId * 4.0 : 0.0;
+            vecBoxes.emplace_back(sDetection.fLeft + fShift, sDetection.fTop, sDetection.fWidth, sDetection.fHeight);
+            vecScores.push_back(sDetection.fScore);
+        }
+        // the top_k of NMSBoxes limits the candidates, not the result
+        cv::dnn::NMSBoxes(vecBoxes, vecScores, -FLT_MAX, fIouThreshold, vecKeep);
+        if (nTopK > 0 && vecKeep.size() > static_cast<size_t>(nTopK))
+        {
+            vecKeep.resize(nTopK);
+        }
+    }
+    else
+    {
+        std::vector<int> vecOrder(vecDetections.size());
+        std::iota(vecOrder.begin(), vecOrder.end(), 0);
+        std::stable_sort(vecOrder.begin(), vecOrder.end(), [&vecDetections](int nFirst, int nSecond)
+        {
+            return vecDetections[nFirst].fScore > vecDetections[nSecond].fScore;
+        });
+
+        // column j of the upper triangular IoU matrix, a box survives if its maximum stays below the threshold
+        for (size_t j = 0; j < vecOrder.size(); ++j)
+        {
+            const tDetection & sCandidate = vecDetections[vecOrder[j]];
+            tBool bSuppressed = tFalse;
+            for (size_t i = 0; i < j && !bSuppressed; ++i)
+            {
+                const tDetection & sBetter = vecDetections[vecOrder[i]];
+                bSuppressed = (!bClassAware || sBetter.nClassId == sCandidate.nClassId) &&
+                    intersection_over_union(sBetter, sCandidate) > fIouThreshold;
+            }
+
+            if (!bSuppressed)
+            {
+                vecKeep.push_back(vecOrder[j]);
+                if (nTopK > 0 && vecKeep.size() >= static_cast<size_t>(nTopK))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<tDetection> vecResult;
+    vecResult.reserve(vecKeep.size());
+    for (int nIndex : vecKeep)
+    {
+        vecResult.push_back(vecDetections[nIndex]);
+    }
+    vecDetections.swap(vecResult);
+}
+
+}
+}
+}
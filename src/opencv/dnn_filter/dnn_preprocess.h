@@ -0,0 +1,269 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace adtf
+{
+namespace videotb
+{
+namespace opencv
+{
+
+struct tBlobParameters
+{
+    cv::Size oSize;
+    /// subtracted before scaling, in the channel order of the blob (R, G, B if bSwapRB is set)
+    cv::Scalar oMean;
+    tFloat64 fScale = 1.0;
+    tBool bSwapRB = tTrue;
+    /// keep the aspect ratio and pad the remaining area
+    tBool bLetterbox = tFalse;
+    /// pixel value of the letterbox border
+    tFloat32 fPadding = 114.0f;
+};
+
+/// Describes where the image ended up within the blob, needed to map detections back onto the image.
+struct tBlobGeometry
+{
+    tFloat32 fScaleX = 1.0f;
+    tFloat32 fScaleY = 1.0f;
+    tInt32 nOffsetX = 0;
+    tInt32 nOffsetY = 0;
+    tInt32 nWidth = 0;
+    tInt32 nHeight = 0;
+};
+
+/**
+ * Maps a box normalized to the blob size back onto the image the blob was filled from.
+ * The result is normalized to the image size.
+ */
+inline cv::Rect2f blob_to_image(const cv::Rect2f & oBox, const cv::Size & oBlobSize, const tBlobGeometry & sGeometry)
+{
+    return cv::Rect2f((oBox.x * oBlobSize.width - sGeometry.nOffsetX) / sGeometry.nWidth,
+        (oBox.y * oBlobSize.height - sGeometry.nOffsetY) / sGeometry.nHeight,
+        oBox.width * oBlobSize.width / sGeometry.nWidth,
+        oBox.height * oBlobSize.height / sGeometry.nHeight);
+}
+
+/**
+ * Fills image nBatchIndex of a preallocated NCHW float blob from a BGR image in a single pass.
+ * Resize (bilinear, optionally letterboxed), mean subtraction, scaling, channel swap and the
+ * HWC to NCHW transpose are done together per blob row. The rows are processed in parallel,
+ * the vertical interpolation and normalization use the OpenCV universal intrinsics.
+ */
+inline tBlobGeometry fill_blob(const cv::Mat & oImage, cv::Mat & oBlob, int nBatchIndex, const tBlobParameters & sParameters)
+{
+    const int nBlobWidth = sParameters.oSize.width;
+    const int nBlobHeight = sParameters.oSize.height;
+
+    CV_Assert(oImage.type() == CV_8UC3 && !oImage.empty());
+    CV_Assert(oBlob.dims == 4 && oBlob.type() == CV_32F && oBlob.size[0] > nBatchIndex && oBlob.size[1] == 3 &&
+              oBlob.size[2] == nBlobHeight && oBlob.size[3] == nBlobWidth);
+
+    tBlobGeometry sGeometry;
+    if (sParameters.bLetterbox)
+    {
+        tFloat32 fScale = std::min(static_cast<tFloat32>(nBlobWidth) / oImage.cols, static_cast<tFloat32>(nBlobHeight) / oImage.rows);
+        sGeometry.fScaleX = fScale;
+        sGeometry.fScaleY = fScale;
+        sGeometry.nWidth = std::min(nBlobWidth, static_cast<int>(std::round(oImage.cols * fScale)));
+        sGeometry.nHeight = std::min(nBlobHeight, static_cast<int>(std::round(oImage.rows * fScale)));
+        sGeometry.nOffsetX = (nBlobWidth - sGeometry.nWidth) / 2;
+        sGeometry.nOffsetY = (nBlobHeight - sGeometry.nHeight) / 2;
+    }
+    else
+    {
+        sGeometry.fScaleX = static_cast<tFloat32>(nBlobWidth) / oImage.cols;
+        sGeometry.fScaleY = static_cast<tFloat32>(nBlobHeight) / oImage.rows;
+        sGeometry.nWidth = nBlobWidth;
+        sGeometry.nHeight = nBlobHeight;
+    }
+
+    float* pPlanes[3];
+    int nSourceChannel[3];
+    float fMul[3];
+    float fAdd[3];
+    float fPadding[3];
+    for (int nChannel = 0; nChannel < 3; ++nChannel)
+    {
+        pPlanes[nChannel] = oBlob.ptr<float>(nBatchIndex, nChannel);
+        nSourceChannel[nChannel] = sParameters.bSwapRB ? 2 - nChannel : nChannel;
+        fMul[nChannel] = static_cast<float>(sParameters.fScale);
+        fAdd[nChannel] = static_cast<float>(-sParameters.oMean[nChannel] * sParameters.fScale);
+        fPadding[nChannel] = sParameters.fPadding * fMul[nChannel] + fAdd[nChannel];
+    }
+
+    // horizontal interpolation table, same pixel center convention as cv::resize
+    const int nWidth = sGeometry.nWidth;
+    cv::AutoBuffer<int, 2048> oX0(nWidth);
+    cv::AutoBuffer<int, 2048> oX1(nWidth);
+    cv::AutoBuffer<float, 2048> oWX(nWidth);
+    for (int x = 0; x < nWidth; ++x)
+    {
+        float fX = std::max((x + 0.5f) / sGeometry.fScaleX - 0.5f, 0.0f);
+        int nX0 = std::min(static_cast<int>(fX), oImage.cols - 1);
+        oX0[x] = nX0 * 3;
+        oX1[x] = std::min(nX0 + 1, oImage.cols - 1) * 3;
+        oWX[x] = nX0 == oImage.cols - 1 ? 0.0f : fX - nX0;
+    }
+
+    cv::parallel_for_(cv::Range(0, nBlobHeight), [&](const cv::Range & oRange)
+    {
+        // two horizontally interpolated source rows, interleaved
+        cv::AutoBuffer<float, 8192> oRows(nWidth * 3 * 2);
+        float* pRow0 = oRows.data();
+        float* pRow1 = pRow0 + nWidth * 3;
+
+        for (int y = oRange.start; y < oRange.end; ++y)
+        {
+            float* pDst[3];
+            for (int nChannel = 0; nChannel < 3; ++nChannel)
+            {
+                pDst[nChannel] = pPlanes[nChannel] + static_cast<size_t>(y) * nBlobWidth;
+            }
+
+            int nImageY = y - sGeometry.nOffsetY;
+            if (nImageY < 0 || nImageY >= sGeometry.nHeight)
+            {
+                for (int nChannel = 0; nChannel < 3; ++nChannel)
+                {
+                    std::fill(pDst[nChannel], pDst[nChannel] + nBlobWidth, fPadding[nChannel]);
+                }
+                continue;
+            }
+
+            for (int nChannel = 0; nChannel < 3; ++nChannel)
+            {
+                std::fill(pDst[nChannel], pDst[nChannel] + sGeometry.nOffsetX, fPadding[nChannel]);
+                std::fill(pDst[nChannel] + sGeometry.nOffsetX + nWidth, pDst[nChannel] + nBlobWidth, fPadding[nChannel]);
+                pDst[nChannel] += sGeometry.nOffsetX;
+            }
+
+            float fY = std::max((nImageY + 0.5f) / sGeometry.fScaleY - 0.5f, 0.0f);
+            int nY0 = std::min(static_cast<int>(fY), oImage.rows - 1);
+            int nY1 = std::min(nY0 + 1, oImage.rows - 1);
+            float fWY = nY0 == oImage.rows - 1 ? 0.0f : fY - nY0;
+
+            const uchar* pSrc0 = oImage.ptr<uchar>(nY0);
+            const uchar* pSrc1 = oImage.ptr<uchar>(nY1);
+            for (int x = 0; x < nWidth; ++x)
+            {
+                const uchar* pLeft0 = pSrc0 + oX0[x];
+                const uchar* pRight0 = pSrc0 + oX1[x];
+                const uchar* pLeft1 = pSrc1 + oX0[x];
+                const uchar* pRight1 = pSrc1 + oX1[x];
+                float fWX = oWX[x];
+                for (int nChannel = 0; nChannel < 3; ++nChannel)
+                {
+                    pRow0[x * 3 + nChannel] = pLeft0[nChannel] + (pRight0[nChannel] - pLeft0[nChannel]) * fWX;
+                    pRow1[x * 3 + nChannel] = pLeft1[nChannel] + (pRight1[nChannel] - pLeft1[nChannel]) * fWX;
+                }
+            }
+
+            int x = 0;
+#if CV_SIMD
+            const cv::v_float32 vW0 = cv::vx_setall_f32(1.0f - fWY);
+            const cv::v_float32 vW1 = cv::vx_setall_f32(fWY);
+            cv::v_float32 vMul[3];
+            cv::v_float32 vAdd[3];
+            for (int nChannel = 0; nChannel < 3; ++nChannel)
+            {
+                vMul[nChannel] = cv::vx_setall_f32(fMul[nChannel]);
+                vAdd[nChannel] = cv::vx_setall_f32(fAdd[nChannel]);
+            }
+
+            for (; x <= nWidth - cv::v_float32::nlanes; x += cv::v_float32::nlanes)
+            {
+                cv::v_float32 vSrc0[3];
+                cv::v_float32 vSrc1[3];
+                cv::v_load_deinterleave(pRow0 + x * 3, vSrc0[0], vSrc0[1], vSrc0[2]);
+                cv::v_load_deinterleave(pRow1 + x * 3, vSrc1[0], vSrc1[1], vSrc1[2]);
+                for (int nChannel = 0; nChannel < 3; ++nChannel)
+                {
+                    int nSource = nSourceChannel[nChannel];
+                    cv::v_float32 vValue = cv::v_fma(vSrc1[nSource], vW1, vSrc0[nSource] * vW0);
+                    cv::v_store(pDst[nChannel] + x, cv::v_fma(vValue, vMul[nChannel], vAdd[nChannel]));
+                }
+            }
+#endif
+            for (; x < nWidth; ++x)
+            {
+                for (int nChannel = 0; nChannel < 3; ++nChannel)
+                {
+                    int nSource = nSourceChannel[nChannel];
+                    float fValue = pRow0[x * 3 + nSource] * (1.0f - fWY) + pRow1[x * 3 + nSource] * fWY;
+                    pDst[nChannel][x] = fValue * fMul[nChannel] + fAdd[nChannel];
+                }
+            }
+        }
+    });
+
+    return sGeometry;
+}
+
+/**
+ * Splits an area of the frame into tiles of at most nTileSize pixels, overlapping by at least nOverlap pixels.
+ * The tiles are spread evenly, so the last row and column end exactly at the border of the area.
+ */
+inline std::vector<cv::Rect> tile_rects(const cv::Rect & oArea, int nTileSize, int nOverlap)
+{
+    auto fnOffsets = [nTileSize, nOverlap](int nLength)
+    {
+        std::vector<int> vecOffsets = { 0 };
+        if (nLength > nTileSize)
+        {
+            const int nStride = std::max(1, nTileSize - nOverlap);
+            const int nCount = 1 + (nLength - nTileSize + nStride - 1) / nStride;
+            for (int nTile = 1; nTile < nCount; ++nTile)
+            {
+                vecOffsets.push_back(static_cast<int>(static_cast<tInt64>(nLength - nTileSize) * nTile / (nCount - 1)));
+            }
+        }
+        return vecOffsets;
+    };
+
+    std::vector<cv::Rect> vecTiles;
+    if (nTileSize <= 0 || oArea.empty())
+    {
+        return vecTiles;
+    }
+
+    const int nWidth = std::min(nTileSize, oArea.width);
+    const int nHeight = std::min(nTileSize, oArea.height);
+    for (int nY : fnOffsets(oArea.height))
+    {
+        for (int nX : fnOffsets(oArea.width))
+        {
+            vecTiles.emplace_back(oArea.x + nX, oArea.y + nY, nWidth, nHeight);
+        }
+    }
+    return vecTiles;
+}
+
+}
+}
+}
@@ -0,0 +1,464 @@
+/**
+ * Copyright 2019 Sebastian Geißler <mail@sebastiangeissler.de>
+ *
+ * (https://opensource.org/licenses/MIT)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+ 
+#include <adtftesting/adtf_testing.h>
+#include <adtffiltersdk/adtf_filtersdk.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <dnn_preprocess.h>
+#include <dnn_motion.h>
+#include <dnn_pipeline.h>
+#include <dnn_postprocess.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace adtf::videotb::opencv;
+using namespace cv;
+
+static Mat create_test_image(int nWidth, int nHeight)
+{
+    Mat oImage(nHeight, nWidth, CV_8UC3);
+    randu(oImage, Scalar::all(0), Scalar::all(255));
+    return oImage;
+}
+
+static tBlobParameters create_parameters(int nSize)
+{
+    tBlobParameters sParameters;
+    sParameters.oSize = Size(nSize, nSize);
+    sParameters.oMean = Scalar(10, 20, 30);
+    sParameters.fScale = 1.0 / 255.0;
+    sParameters.bSwapRB = tTrue;
+    return sParameters;
+}
+
+TEST_CASE("fill_blob matches blobFromImage")
+{
+    Mat oImage = create_test_image(1280, 720);
+    tBlobParameters sParameters = create_parameters(416);
+
+    Mat oExpected = dnn::blobFromImage(oImage, sParameters.fScale, sParameters.oSize, sParameters.oMean, true, false);
+
+    int vecShape[] = { 1, 3, 416, 416 };
+    Mat oBlob(4, vecShape, CV_32F);
+    fill_blob(oImage, oBlob, 0, sParameters);
+
+    // cv::resize rounds to uchar before the normalization, so a difference of one pixel value is expected
+    REQUIRE(norm(oBlob, oExpected, NORM_INF) <= 1.01 * sParameters.fScale);
+}
+
+TEST_CASE("fill_blob letterbox")
+{
+    Mat oImage = Mat(100, 200, CV_8UC3, Scalar(50, 100, 150));
+    tBlobParameters sParameters = create_parameters(64);
+    sParameters.bLetterbox = tTrue;
+
+    int vecShape[] = { 2, 3, 64, 64 };
+    Mat oBlob(4, vecShape, CV_32F, Scalar(0));
+    tBlobGeometry sGeometry = fill_blob(oImage, oBlob, 1, sParameters);
+
+    REQUIRE(sGeometry.nWidth == 64);
+    REQUIRE(sGeometry.nHeight == 32);
+    REQUIRE(sGeometry.nOffsetX == 0);
+    REQUIRE(sGeometry.nOffsetY == 16);
+
+    // first image of the batch is untouched
+    REQUIRE(oBlob.ptr<float>(0, 0)[0] == 0.0f);
+
+    // channel 0 is red after the swap
+    const float* pRed = oBlob.ptr<float>(1, 0);
+    REQUIRE(pRed[0] == Approx((114.0 - 10.0) / 255.0));
+    REQUIRE(pRed[32 * 64 + 32] == Approx((150.0 - 10.0) / 255.0));
+    REQUIRE(pRed[63 * 64 + 63] == Approx((114.0 - 10.0) / 255.0));
+
+    const float* pBlue = oBlob.ptr<float>(1, 2);
+    REQUIRE(pBlue[32 * 64 + 32] == Approx((50.0 - 30.0) / 255.0));
+}
+
+TEST_CASE("tile_rects covers the area with overlapping tiles")
+{
+    std::vector<Rect> vecTiles = tile_rects(Rect(0, 0, 3840, 2160), 640, 64);
+    // 7 columns and 4 rows are needed for a stride of at most 576 pixels
+    REQUIRE(vecTiles.size() == 7 * 4);
+    REQUIRE(vecTiles.front() == Rect(0, 0, 640, 640));
+    REQUIRE(vecTiles.back() == Rect(3200, 1520, 640, 640));
+    REQUIRE(vecTiles[1].x <= 640 - 64);
+
+    vecTiles = tile_rects(Rect(100, 50, 300, 200), 640, 64);
+    REQUIRE(vecTiles.size() == 1);
+    REQUIRE(vecTiles[0] == Rect(100, 50, 300, 200));
+}
+
+TEST_CASE("motion detector finds the changed region")
+{
+    cMotionDetector oDetector;
+    Mat oMask;
+    Rect oRoi;
+
+    Mat oScene(480, 640, CV_8UC3, Scalar(80, 80, 80));
+    // the first frame initializes the background
+    REQUIRE(oDetector.Detect(oScene, oMask, oRoi));
+    REQUIRE(oRoi == Rect(0, 0, 640, 480));
+
+    REQUIRE_FALSE(oDetector.Detect(oScene, oMask, oRoi));
+    REQUIRE(countNonZero(oMask) == 0);
+
+    Mat oMoved = oScene.clone();
+    rectangle(oMoved, Rect(400, 300, 80, 60), Scalar(250, 250, 250), FILLED);
+    REQUIRE(oDetector.Detect(oMoved, oMask, oRoi));
+    REQUIRE(oMask.cols == 160);
+    // the mask is dilated and downscaled, so the region is slightly larger than the object
+    REQUIRE((oRoi & Rect(400, 300, 80, 60)) == Rect(400, 300, 80, 60));
+    REQUIRE(oRoi.area() < 4 * 80 * 60);
+
+    Rect oExpanded = expand_roi(oRoi, oScene.size());
+    REQUIRE((oExpanded & oRoi) == oRoi);
+
+    tDetection sDetection = { 0.5f, 0.5f, 0.5f, 0.5f, 0, 1.0f };
+    roi_to_frame(sDetection, Rect(320, 240, 320, 240), Size(640, 480));
+    REQUIRE(sDetection.fLeft == Approx(0.75f));
+    REQUIRE(sDetection.fTop == Approx(0.75f));
+    REQUIRE(sDetection.fWidth == Approx(0.25f));
+    REQUIRE(sDetection.fHeight == Approx(0.25f));
+}
+
+static adtf::ucom::object_ptr<const adtf::streaming::ISample> create_frame(tTimeStamp tmTime)
+{
+    adtf::ucom::object_ptr<adtf::streaming::ISample> pSample = adtf::ucom::make_object_ptr<adtf::streaming::cSample>();
+    pSample->SetTime(tmTime);
+    return pSample;
+}
+
+TEST_CASE("detection sequencer keeps skipped frames in order")
+{
+    cDetectionSequencer oSequencer;
+    std::vector<std::pair<tTimeStamp, tSize>> vecEmitted;
+    auto fnEmit = [&vecEmitted](const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame, const std::vector<tDetection>& vecDetections,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pResult)
+    {
+        vecEmitted.push_back({ pFrame->GetTime(), vecDetections.size() });
+    };
+
+    const tDetection sDetection = { 0.1f, 0.1f, 0.2f, 0.2f, 1, 0.9f };
+    const tUInt64 nFirst = oSequencer.Next();
+    const tUInt64 nSkipped = oSequencer.Next();
+    const tUInt64 nDropped = oSequencer.Next();
+    const tUInt64 nSecond = oSequencer.Next();
+
+    // the skipped frame arrives while the first one is still in the pipeline
+    oSequencer.PassThrough(nSkipped, create_frame(2), fnEmit);
+    oSequencer.Drop(nDropped, fnEmit);
+    oSequencer.Complete(nSecond, create_frame(4), std::vector<tDetection>(), create_frame(4), fnEmit);
+    REQUIRE(vecEmitted.empty());
+    REQUIRE(oSequencer.GetPending() == 3);
+
+    oSequencer.Complete(nFirst, create_frame(1), { sDetection, sDetection }, create_frame(1), fnEmit);
+    REQUIRE(oSequencer.GetPending() == 0);
+    // the skipped frame gets the detections of the inferred frame before it, the dropped one is not sent
+    REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tSize>>({ { 1, 2 }, { 2, 2 }, { 4, 0 } }));
+
+    // a new run starts without the detections of the previous one
+    oSequencer.Reset();
+    vecEmitted.clear();
+    REQUIRE(oSequencer.Next() == 0);
+    oSequencer.PassThrough(0, create_frame(5), fnEmit);
+    REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tSize>>({ { 5, 0 } }));
+}
+
+TEST_CASE("detection sequencer orders the results of concurrently emitted batches")
+{
+    cDetectionSequencer oSequencer;
+    std::vector<tTimeStamp> vecResults;
+    std::vector<tTimeStamp> vecFrames;
+    auto fnEmit = [&vecResults, &vecFrames](const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame, const std::vector<tDetection>& vecDetections,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pResult)
+    {
+        // called with the lock of the sequencer held
+        vecFrames.push_back(pFrame->GetTime());
+        if (pResult)
+        {
+            vecResults.push_back(pResult->GetTime());
+        }
+    };
+
+    // batches of two frames, flushed alternately by a trigger thread and the timeout thread
+    const tUInt64 nFrames = 1000;
+    std::vector<tUInt64> vecSequences;
+    for (tUInt64 nFrame = 0; nFrame < nFrames; ++nFrame)
+    {
+        vecSequences.push_back(oSequencer.Next());
+    }
+
+    auto fnFlush = [&](tUInt64 nFirstBatch)
+    {
+        for (tUInt64 nFrame = nFirstBatch * 2; nFrame < nFrames; nFrame += 4)
+        {
+            for (tUInt64 nImage = nFrame; nImage < nFrame + 2; ++nImage)
+            {
+                const tTimeStamp tmFrame = static_cast<tTimeStamp>(nImage);
+                // every third frame is skipped and has no result of its own
+                if (nImage % 3 == 0)
+                {
+                    oSequencer.PassThrough(vecSequences[nImage], create_frame(tmFrame), fnEmit);
+                }
+                else
+                {
+                    oSequencer.Complete(vecSequences[nImage], create_frame(tmFrame), std::vector<tDetection>(), create_frame(tmFrame), fnEmit);
+                }
+            }
+        }
+    };
+
+    std::thread oTrigger(fnFlush, 0);
+    std::thread oTimeout(fnFlush, 1);
+    oTrigger.join();
+    oTimeout.join();
+
+    REQUIRE(oSequencer.GetPending() == 0);
+    REQUIRE(vecFrames.size() == nFrames);
+    REQUIRE(std::is_sorted(vecFrames.begin(), vecFrames.end()));
+    REQUIRE(vecResults.size() == nFrames - (nFrames + 2) / 3);
+    REQUIRE(std::is_sorted(vecResults.begin(), vecResults.end()));
+}
+
+TEST_CASE("decode_region_rows rejects low objectness and picks the best class")
+{
+    // center x, center y, width, height, objectness, three class scores
+    Mat oRows = (Mat_<float>(3, 8) <<
+        0.5f, 0.5f, 0.2f, 0.4f, 0.9f, 0.1f, 0.8f, 0.3f,
+        0.2f, 0.2f, 0.1f, 0.1f, 0.1f, 0.9f, 0.9f, 0.9f,
+        0.7f, 0.7f, 0.2f, 0.2f, 0.9f, 0.1f, 0.1f, 0.2f);
+
+    std::vector<tDetection> vecDetections;
+    decode_region_rows(oRows, 0.5f, 0.25f, vecDetections);
+
+    // the second row fails the objectness, the third one the class score
+    REQUIRE(vecDetections.size() == 1);
+    REQUIRE(vecDetections[0].nClassId == 1);
+    REQUIRE(vecDetections[0].fScore == Approx(0.8f));
+    REQUIRE(vecDetections[0].fLeft == Approx(0.4f));
+    REQUIRE(vecDetections[0].fTop == Approx(0.3f));
+    REQUIRE(vecDetections[0].fWidth == Approx(0.2f));
+    REQUIRE(vecDetections[0].fHeight == Approx(0.4f));
+}
+
+TEST_CASE("decode_region_rows finds the maximum beyond the vector width")
+{
+    // more classes than lanes of any vector register, the best one in the scalar tail
+    const int nClasses = 83;
+    Mat oRows(1, 5 + nClasses, CV_32F, Scalar(0.1f));
+    oRows.at<float>(0, 4) = 1.0f;
+    oRows.at<float>(0, 5 + nClasses - 1) = 0.7f;
+
+    std::vector<tDetection> vecDetections;
+    decode_region_rows(oRows, 0.5f, 0.25f, vecDetections);
+
+    REQUIRE(vecDetections.size() == 1);
+    REQUIRE(vecDetections[0].nClassId == nClasses - 1);
+    REQUIRE(vecDetections[0].fScore == Approx(0.7f));
+}
+
+static std::vector<tDetection> create_overlapping_detections()
+{
+    return {
+        { 0.10f, 0.10f, 0.20f, 0.20f, 0, 0.9f },
+        // overlaps the first one of the same class
+        { 0.12f, 0.10f, 0.20f, 0.20f, 0, 0.8f },
+        // same place, other class
+        { 0.11f, 0.10f, 0.20f, 0.20f, 1, 0.7f },
+        // overlaps only the second one
+        { 0.19f, 0.10f, 0.20f, 0.20f, 0, 0.6f },
+        { 0.60f, 0.60f, 0.10f, 0.10f, 0, 0.5f }
+    };
+}
+
+static std::vector<tFloat32> get_scores(const std::vector<tDetection>& vecDetections)
+{
+    std::vector<tFloat32> vecScores;
+    for (auto & sDetection : vecDetections)
+    {
+        vecScores.push_back(sDetection.fScore);
+    }
+    return vecScores;
+}
+
+TEST_CASE("suppress_detections greedy")
+{
+    std::vector<tDetection> vecDetections = create_overlapping_detections();
+
+    SECTION("class aware")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Greedy, tTrue, 0);
+        // the fourth box survives, the box suppressing it is suppressed itself
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f, 0.7f, 0.6f, 0.5f }));
+    }
+
+    SECTION("class agnostic")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Greedy, tFalse, 0);
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f, 0.6f, 0.5f }));
+    }
+
+    SECTION("top k")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Greedy, tTrue, 2);
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f, 0.7f }));
+    }
+}
+
+TEST_CASE("suppress_detections fast")
+{
+    std::vector<tDetection> vecDetections = create_overlapping_detections();
+
+    SECTION("class aware")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Fast, tTrue, 0);
+        // suppressed boxes still suppress, so the fourth box is removed by the second one
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f, 0.7f, 0.5f }));
+    }
+
+    SECTION("class agnostic")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Fast, tFalse, 0);
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f, 0.5f }));
+    }
+
+    SECTION("top k")
+    {
+        suppress_detections(vecDetections, 0.45f, NMS_Fast, tTrue, 1);
+        REQUIRE(get_scores(vecDetections) == std::vector<tFloat32>({ 0.9f }));
+    }
+}
+
+TEST_CASE("frame synchronizer pairs frames and detections by sample time")
+{
+    cFrameSynchronizer oSynchronizer;
+    // 5 ms tolerance, 100 ms maximum latency, all times in us
+    oSynchronizer.Configure(5000, 100000, 16, LP_EmitWithoutDetections);
+
+    std::vector<std::pair<tTimeStamp, tTimeStamp>> vecEmitted;
+    auto fnEmit = [&vecEmitted](const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pFrame,
+        const adtf::ucom::object_ptr<const adtf::streaming::ISample>& pDetections) -> tResult
+    {
+        vecEmitted.push_back({ pFrame->GetTime(), pDetections ? pDetections->GetTime() : -1 });
+        RETURN_NOERROR;
+    };
+
+    SECTION("frames wait for their detections")
+    {
+        oSynchronizer.AddFrame(create_frame(0));
+        oSynchronizer.AddFrame(create_frame(40000));
+        REQUIRE(IS_OK(oSynchronizer.Emit(40000, fnEmit)));
+        REQUIRE(vecEmitted.empty());
+
+        // the detections may be a bit off
+        oSynchronizer.AddDetections(create_frame(2000));
+        REQUIRE(IS_OK(oSynchronizer.Emit(40000, fnEmit)));
+        REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tTimeStamp>>({ { 0, 2000 } }));
+        REQUIRE(oSynchronizer.GetPendingFrames() == 1);
+    }
+
+    SECTION("skipped frames are emitted once a later detection arrived")
+    {
+        oSynchronizer.AddFrame(create_frame(0));
+        oSynchronizer.AddFrame(create_frame(40000));
+        oSynchronizer.AddFrame(create_frame(80000));
+        // the detections of the first frame were dropped, the ones of the second frame are late
+        oSynchronizer.AddDetections(create_frame(80000));
+        REQUIRE(IS_OK(oSynchronizer.Emit(80000, fnEmit)));
+
+        REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tTimeStamp>>({ { 0, -1 }, { 40000, -1 }, { 80000, 80000 } }));
+        REQUIRE(oSynchronizer.GetUnmatchedFrames() == 2);
+        REQUIRE(oSynchronizer.GetDroppedFrames() == 0);
+    }
+
+    SECTION("detections of emitted frames are discarded")
+    {
+        oSynchronizer.AddFrame(create_frame(0));
+        REQUIRE(IS_OK(oSynchronizer.Emit(200000, fnEmit)));
+        REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tTimeStamp>>({ { 0, -1 } }));
+
+        // arrive after the frame timed out
+        oSynchronizer.AddDetections(create_frame(0));
+        oSynchronizer.AddFrame(create_frame(200000));
+        oSynchronizer.AddDetections(create_frame(200000));
+        REQUIRE(IS_OK(oSynchronizer.Emit(200000, fnEmit)));
+        REQUIRE(vecEmitted.back() == std::pair<tTimeStamp, tTimeStamp>(200000, 200000));
+    }
+
+    SECTION("late frames are dropped with the drop policy")
+    {
+        oSynchronizer.Configure(5000, 100000, 16, LP_DropFrame);
+        oSynchronizer.AddFrame(create_frame(0));
+        oSynchronizer.AddFrame(create_frame(120000));
+        REQUIRE(IS_OK(oSynchronizer.Emit(120000, fnEmit)));
+
+        REQUIRE(vecEmitted.empty());
+        REQUIRE(oSynchronizer.GetDroppedFrames() == 1);
+        REQUIRE(oSynchronizer.GetPendingFrames() == 1);
+    }
+
+    SECTION("the buffer size limits the waiting frames")
+    {
+        oSynchronizer.Configure(5000, 100000, 2, LP_EmitWithoutDetections);
+        for (tTimeStamp tmFrame = 0; tmFrame < 3000; tmFrame += 1000)
+        {
+            oSynchronizer.AddFrame(create_frame(tmFrame));
+        }
+        REQUIRE(IS_OK(oSynchronizer.Emit(2000, fnEmit)));
+
+        REQUIRE(vecEmitted == std::vector<std::pair<tTimeStamp, tTimeStamp>>({ { 0, -1 } }));
+        REQUIRE(oSynchronizer.GetPendingFrames() == 2);
+    }
+}
+
+TEST_CASE("fill_blob benchmark", "[.benchmark]")
+{
+    const int nIterations = 100;
+    Mat oImage = create_test_image(1920, 1080);
+
+    for (int nSize : { 416, 640 })
+    {
+        tBlobParameters sParameters = create_parameters(nSize);
+        int vecShape[] = { 1, 3, nSize, nSize };
+        Mat oBlob(4, vecShape, CV_32F);
+
+        auto tmStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < nIterations; i++)
+        {
+            dnn::blobFromImage(oImage, oBlob, sParameters.fScale, sParameters.oSize, sParameters.oMean, true, false);
+        }
+        auto tmBlobFromImage = std::chrono::high_resolution_clock::now() - tmStart;
+
+        tmStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < nIterations; i++)
+        {
+            fill_blob(oImage, oBlob, 0, sParameters);
+        }
+        auto tmFillBlob = std::chrono::high_resolution_clock::now() - tmStart;
+
+        WARN("1080p to " << nSize << "x" << nSize << " blob, blobFromImage: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(tmBlobFromImage).count() / nIterations << " us/frame, fill_blob: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(tmFillBlob).count() / nIterations << " us/frame");
+    }
+}
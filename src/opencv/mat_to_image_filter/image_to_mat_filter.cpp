@@ -50,6 +50,9 @@ private:
     tInt32 m_nMatType;
     tInt32 m_nSize;
 
+    property_variable<tBool> m_bZeroCopy = tFalse;
+    property_variable<tBool> m_bSwapRedBlue = tTrue;
+
 public:
     ADTF_CLASS_ID_NAME(cImageToMatFilter,
         "image_to_mat.opencv.videotb.cid",
@@ -64,6 +67,12 @@ public:
         object_ptr<IStreamType> pImageStreamType = make_object_ptr<cStreamType>(stream_meta_type_image());
         m_pInput = CreateInputPin("image", pImageStreamType);
 
+        m_bZeroCopy.SetDescription("Wrap the image sample memory instead of copying it. "
+                                   "Only takes effect if no channel swap is required.");
+        RegisterPropertyVariable("zero_copy", m_bZeroCopy);
+        m_bSwapRedBlue.SetDescription("Convert RGB images to the OpenCV BGR channel order.");
+        RegisterPropertyVariable("swap_red_blue", m_bSwapRedBlue);
+
         m_pInput->SetAcceptTypeCallback([this](const auto & pStreamType) -> tResult
         {
             RETURN_IF_FAILED(get_stream_type_image_format(m_sCurrentFormat, *pStreamType.Get()));
@@ -102,13 +111,29 @@ public:
                 RETURN_ERROR_DESC(ERR_NOT_SUPPORTED, "received sample size miss match %d != %d", pBuffer->GetSize(), m_nSize);
             }
 
-            Mat oMat = Mat(m_sCurrentFormat.m_ui32Height,
-                           m_sCurrentFormat.m_ui32Width,
-                           m_nMatType);
+            // header only, the image data stays in the sample buffer
+            Mat oImage = Mat(m_sCurrentFormat.m_ui32Height,
+                             m_sCurrentFormat.m_ui32Width,
+                             m_nMatType,
+                             const_cast<tVoid*>(pBuffer->GetPtr()));
 
-            cMemoryBlock::MemCopy(oMat.data, pBuffer->GetPtr(), m_nSize);
-            cv::cvtColor(oMat, oMat, cv::COLOR_RGB2BGR);
-            object_ptr<const ISample> pOutSample = make_object_ptr<cOpenCVSample>(oMat);
+            object_ptr<const ISample> pOutSample;
+            if (m_bSwapRedBlue && m_nMatType == CV_8UC3)
+            {
+                // the swap reads the sample buffer and writes the new Mat in one pass
+                Mat oMat;
+                cv::cvtColor(oImage, oMat, cv::COLOR_RGB2BGR);
+                pOutSample = make_object_ptr<cOpenCVSample>(oMat);
+            }
+            else if (m_bZeroCopy)
+            {
+                // the output sample holds the input sample and its shared lock until the last reference is gone
+                pOutSample = make_object_ptr<cOpenCVSample>(oImage, pSample, std::move(pBuffer));
+            }
+            else
+            {
+                pOutSample = make_object_ptr<cOpenCVSample>(oImage.clone());
+            }
             m_pOutput->Write(pOutSample);
         }
         RETURN_NOERROR;
@@ -178,7 +203,8 @@ public:
         {
             if (object_ptr<const IOpenCVSample> pMatSample = pSample)
             {
-                cv::Mat oMat = pMatSample->GetMat();
+                // the input may be shared with other consumers and must not be modified
+                const cv::Mat & oMat = pMatSample->GetMat();
 
                 tInt64 nSize = oMat.total() * oMat.elemSize();
                 if (nSize != m_nSize)
@@ -191,15 +217,23 @@ public:
                     RETURN_ERROR_DESC(ERR_NOT_SUPPORTED, "Recived Mat type missmatch %d != %d", oMat.type(), m_nMatType);
                 }
 
-                cv::cvtColor(oMat, oMat, COLOR_BGR2RGB);
-
                 object_ptr<ISample> pNewSample;
                 if (IS_OK(alloc_sample(pNewSample, pSample->GetTime())))
                 {
                     object_ptr_locked<ISampleBuffer> pBuffer;
                     if (IS_OK(pNewSample->WriteLock(pBuffer, m_nSize)))
                     {
-                        cMemoryBlock::MemCopy(pBuffer->GetPtr(), oMat.data, m_nSize);
+                        // header on the sample memory, the Mat is read once and written straight into the buffer.
+                        // cvtColor takes care of strided input and uses the SIMD kernels of the running CPU.
+                        Mat oImage(oMat.rows, oMat.cols, oMat.type(), pBuffer->GetPtr());
+                        if (m_nMatType == CV_8UC3)
+                        {
+                            cv::cvtColor(oMat, oImage, COLOR_BGR2RGB);
+                        }
+                        else
+                        {
+                            oMat.copyTo(oImage);
+                        }
                     }
                     m_pOutput->Write(pNewSample);
                 }
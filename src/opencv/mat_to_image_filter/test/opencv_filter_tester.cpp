@@ -24,6 +24,9 @@
 #include <opencv_base_filter/opencv_sample.h>
 
 #include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
 
 using namespace adtf::util;
 using namespace adtf::ucom;
@@ -147,4 +150,127 @@ TEST_CASE_METHOD(cMyTestSystem, "Image to Mat")
     REQUIRE(oVector[0] == 1);
     REQUIRE(oVector[1] == 2);
     REQUIRE(oVector[2] == 3);
-}
\ No newline at end of file
+}
+TEST_CASE_METHOD(cMyTestSystem, "Image to Mat zero copy")
+{
+    adtf::ucom::object_ptr<adtf::streaming::IFilter> pFilter;
+    REQUIRE_OK(_runtime->CreateInstance("image_to_mat.opencv.videotb.cid", pFilter));
+
+    object_ptr<IConfiguration> pConfig = pFilter;
+    REQUIRE(pConfig);
+    REQUIRE_OK(set_property<tBool>(*pConfig, "zero_copy", tTrue));
+    REQUIRE_OK(set_property<tBool>(*pConfig, "swap_red_blue", tFalse));
+
+    tStreamImageFormat m_sCurrentFormat;
+    m_sCurrentFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGB_24);
+    m_sCurrentFormat.m_ui32Height = 2;
+    m_sCurrentFormat.m_ui32Width = 2;
+    m_sCurrentFormat.m_szMaxByteSize = m_sCurrentFormat.m_ui32Width * m_sCurrentFormat.m_ui32Height * 3;
+
+    object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_image());
+    set_stream_type_image_format(*pStreamType, m_sCurrentFormat);
+
+    adtf::filter::testing::cTestWriter oImage(pFilter, "image", pStreamType);
+    adtf::filter::testing::cOutputRecorder oMat(pFilter, "mat");
+
+    REQUIRE_OK(pFilter->SetState(adtf::streaming::IFilter::tFilterState::State_Running));
+
+    auto pInputSample = CreateImage(2, 2);
+    oImage.WriteSample(pInputSample);
+    oImage.ManualTrigger();
+
+    auto oOutputSamples = oMat.GetCurrentOutput().GetSamples();
+
+    REQUIRE(oOutputSamples.size() == 1);
+
+    object_ptr<const IOpenCVSample> pOpenCVSample = oOutputSamples.back();
+    REQUIRE(pOpenCVSample);
+
+    object_ptr_shared_locked<const ISampleBuffer> pBuffer;
+    REQUIRE(IS_OK(pInputSample->Lock(pBuffer)));
+
+    Mat oResultMat = pOpenCVSample->GetMat();
+    REQUIRE(oResultMat.data == pBuffer->GetPtr());
+
+    Vec3b oVector = oResultMat.at<Vec3b>(0, 1);
+    REQUIRE(oVector[0] == 1);
+    REQUIRE(oVector[1] == 2);
+    REQUIRE(oVector[2] == 3);
+}
+
+TEST_CASE_METHOD(cMyTestSystem, "Mat To Image strided")
+{
+    adtf::ucom::object_ptr<adtf::streaming::IFilter> pFilter;
+    REQUIRE_OK(_runtime->CreateInstance("mat_to_image.opencv.videotb.cid", pFilter));
+
+    tStreamImageFormat m_sCurrentFormat;
+    m_sCurrentFormat.m_strFormatName = ADTF_IMAGE_FORMAT(RGB_24);
+    m_sCurrentFormat.m_ui32Height = 2;
+    m_sCurrentFormat.m_ui32Width = 2;
+    m_sCurrentFormat.m_szMaxByteSize = m_sCurrentFormat.m_ui32Width * m_sCurrentFormat.m_ui32Height * 3;
+
+    object_ptr<IStreamType> pStreamType = make_object_ptr<cStreamType>(stream_meta_type_mat());
+    REQUIRE(IS_OK(set_stream_type_mat_format(*pStreamType, m_sCurrentFormat)));
+
+    adtf::filter::testing::cTestWriter oImage(pFilter, "mat", pStreamType);
+    adtf::filter::testing::cOutputRecorder oMat(pFilter, "image");
+
+    REQUIRE_OK(pFilter->SetState(adtf::streaming::IFilter::tFilterState::State_Running));
+
+    // a 2x2 roi of a 4x4 image is not continuous
+    Mat oFullMat = Mat(4, 4, CV_8UC3, Scalar(1, 2, 3));
+    Mat oRoiMat = oFullMat(Rect(1, 1, 2, 2));
+    REQUIRE(!oRoiMat.isContinuous());
+
+    oImage.WriteSample(make_object_ptr<cOpenCVSample>(oRoiMat));
+    oImage.ManualTrigger();
+
+    auto oOutputSamples = oMat.GetCurrentOutput().GetSamples();
+    REQUIRE(oOutputSamples.size() == 1);
+
+    object_ptr_shared_locked<const ISampleBuffer> pBuffer;
+    REQUIRE(IS_OK(oOutputSamples.back()->Lock(pBuffer)));
+    REQUIRE(pBuffer->GetSize() == 2 * 2 * 3);
+
+    const tUInt8* pData = reinterpret_cast<const tUInt8*>(pBuffer->GetPtr());
+    for (int i = 0; i < 2 * 2; i++)
+    {
+        REQUIRE(pData[i * 3] == 3);
+        REQUIRE(pData[i * 3 + 1] == 2);
+        REQUIRE(pData[i * 3 + 2] == 1);
+    }
+
+    // the input mat is left untouched
+    Vec3b oVector = oFullMat.at<Vec3b>(1, 1);
+    REQUIRE(oVector[0] == 1);
+    REQUIRE(oVector[2] == 3);
+}
+
+TEST_CASE("Mat To Image conversion benchmark", "[.benchmark]")
+{
+    const int nIterations = 200;
+    Mat oMat = Mat(1080, 1920, CV_8UC3);
+    randu(oMat, Scalar::all(0), Scalar::all(255));
+    std::vector<tUInt8> oBuffer(oMat.total() * oMat.elemSize());
+
+    auto tmStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nIterations; i++)
+    {
+        // previous implementation: in place swap followed by a copy into the sample buffer
+        cv::cvtColor(oMat, oMat, COLOR_BGR2RGB);
+        cMemoryBlock::MemCopy(oBuffer.data(), oMat.data, oBuffer.size());
+    }
+    auto tmTwoPass = std::chrono::high_resolution_clock::now() - tmStart;
+
+    tmStart = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nIterations; i++)
+    {
+        Mat oImage(oMat.rows, oMat.cols, oMat.type(), oBuffer.data());
+        cv::cvtColor(oMat, oImage, COLOR_BGR2RGB);
+    }
+    auto tmFused = std::chrono::high_resolution_clock::now() - tmStart;
+
+    WARN("1080p BGR to RGB, two pass: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(tmTwoPass).count() / nIterations << " us/frame, fused: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(tmFused).count() / nIterations << " us/frame");
+}
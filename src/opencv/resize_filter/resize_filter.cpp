@@ -65,11 +65,11 @@ public:
         return oResultImageFormat;
     }
 
-    cv::Mat ProcessMat(const cv::Mat & oMat)
+    tResult ProcessMat(const cv::Mat & oMat, cv::Mat & oResult) override
     {
-        cv::Mat oResult;
+        // oResult is a pooled buffer of the output size, resize writes into it without reallocation
         resize(oMat, oResult, Size(m_nWidth, m_nHeight));
-        return oResult;
+        RETURN_NOERROR;
     }
 };
 